@@ -0,0 +1,624 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace graph {
+
+namespace detail {
+
+// Min-plus релаксация отрезка строки: row[j] = min(row[j], weight_from + through[j]) для j из [begin, end)
+// с переносом номера последнего ребра пути из строки through.
+template <typename StoredWeight, typename EdgeIndex>
+inline void RelaxRow(StoredWeight weight_from, const StoredWeight* weights_through, const EdgeIndex* prev_edges_through,
+                     StoredWeight* weights_row, EdgeIndex* prev_edges_row, size_t begin, size_t end) {
+    for (size_t index = begin; index < end; ++index) {
+        const StoredWeight candidate_weight = weight_from + weights_through[index];
+        if (candidate_weight < weights_row[index]) {
+            weights_row[index] = candidate_weight;
+            prev_edges_row[index] = prev_edges_through[index];
+        }
+    }
+}
+
+#if defined(__AVX__)
+// Векторный вариант для float: по 8 ячеек за итерацию, выбор ребра по маске сравнения
+inline void RelaxRow(float weight_from, const float* weights_through, const uint32_t* prev_edges_through,
+                     float* weights_row, uint32_t* prev_edges_row, size_t begin, size_t end) {
+    const __m256 weight_from_x8 = _mm256_set1_ps(weight_from);
+    size_t index = begin;
+    for (; index + 8 <= end; index += 8) {
+        const __m256 candidate = _mm256_add_ps(weight_from_x8, _mm256_loadu_ps(weights_through + index));
+        const __m256 current = _mm256_loadu_ps(weights_row + index);
+        const __m256 is_better = _mm256_cmp_ps(candidate, current, _CMP_LT_OQ);
+        _mm256_storeu_ps(weights_row + index, _mm256_min_ps(candidate, current));
+
+        const __m256 prev_through = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_edges_through + index)));
+        const __m256 prev_current = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_edges_row + index)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(prev_edges_row + index),
+                            _mm256_castps_si256(_mm256_blendv_ps(prev_current, prev_through, is_better)));
+    }
+    RelaxRow<float, uint32_t>(weight_from, weights_through, prev_edges_through, weights_row, prev_edges_row, index, end);
+}
+#elif defined(__SSE2__)
+// Векторный вариант для float: по 4 ячейки за итерацию, выбор ребра по маске сравнения
+inline void RelaxRow(float weight_from, const float* weights_through, const uint32_t* prev_edges_through,
+                     float* weights_row, uint32_t* prev_edges_row, size_t begin, size_t end) {
+    const __m128 weight_from_x4 = _mm_set1_ps(weight_from);
+    size_t index = begin;
+    for (; index + 4 <= end; index += 4) {
+        const __m128 candidate = _mm_add_ps(weight_from_x4, _mm_loadu_ps(weights_through + index));
+        const __m128 current = _mm_loadu_ps(weights_row + index);
+        const __m128i is_better = _mm_castps_si128(_mm_cmplt_ps(candidate, current));
+        _mm_storeu_ps(weights_row + index, _mm_min_ps(candidate, current));
+
+        const __m128i prev_through = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_edges_through + index));
+        const __m128i prev_current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_edges_row + index));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(prev_edges_row + index),
+                         _mm_or_si128(_mm_and_si128(is_better, prev_through), _mm_andnot_si128(is_better, prev_current)));
+    }
+    RelaxRow<float, uint32_t>(weight_from, weights_through, prev_edges_through, weights_row, prev_edges_row, index, end);
+}
+#endif
+
+// Векторные варианты для весов в фиксированной точке: с SSE4.1 и AVX2 - беззнаковый min вместо сравнения,
+// ребро меняется там, где минимум отличается от прежнего значения ячейки.
+// Переполнения нет: конечные веса меньше 2^31, бесконечность - 2^31.
+#if defined(__AVX2__)
+inline void RelaxRow(uint32_t weight_from, const uint32_t* weights_through, const uint32_t* prev_edges_through,
+                     uint32_t* weights_row, uint32_t* prev_edges_row, size_t begin, size_t end) {
+    const __m256i weight_from_x8 = _mm256_set1_epi32(static_cast<int>(weight_from));
+    size_t index = begin;
+    for (; index + 8 <= end; index += 8) {
+        const __m256i candidate = _mm256_add_epi32(weight_from_x8, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights_through + index)));
+        const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights_row + index));
+        const __m256i best = _mm256_min_epu32(candidate, current);
+        const __m256i is_same = _mm256_cmpeq_epi32(best, current);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(weights_row + index), best);
+
+        const __m256i prev_through = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_edges_through + index));
+        const __m256i prev_current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_edges_row + index));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(prev_edges_row + index), _mm256_blendv_epi8(prev_through, prev_current, is_same));
+    }
+    RelaxRow<uint32_t, uint32_t>(weight_from, weights_through, prev_edges_through, weights_row, prev_edges_row, index, end);
+}
+#elif defined(__SSE4_1__)
+inline void RelaxRow(uint32_t weight_from, const uint32_t* weights_through, const uint32_t* prev_edges_through,
+                     uint32_t* weights_row, uint32_t* prev_edges_row, size_t begin, size_t end) {
+    const __m128i weight_from_x4 = _mm_set1_epi32(static_cast<int>(weight_from));
+    size_t index = begin;
+    for (; index + 4 <= end; index += 4) {
+        const __m128i candidate = _mm_add_epi32(weight_from_x4, _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights_through + index)));
+        const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights_row + index));
+        const __m128i best = _mm_min_epu32(candidate, current);
+        const __m128i is_same = _mm_cmpeq_epi32(best, current);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(weights_row + index), best);
+
+        const __m128i prev_through = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_edges_through + index));
+        const __m128i prev_current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_edges_row + index));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(prev_edges_row + index), _mm_blendv_epi8(prev_through, prev_current, is_same));
+    }
+    RelaxRow<uint32_t, uint32_t>(weight_from, weights_through, prev_edges_through, weights_row, prev_edges_row, index, end);
+}
+#elif defined(__SSE2__)
+// В SSE2 нет беззнакового сравнения: после инверсии старшего бита его заменяет знаковое
+inline void RelaxRow(uint32_t weight_from, const uint32_t* weights_through, const uint32_t* prev_edges_through,
+                     uint32_t* weights_row, uint32_t* prev_edges_row, size_t begin, size_t end) {
+    const __m128i weight_from_x4 = _mm_set1_epi32(static_cast<int>(weight_from));
+    const __m128i sign_bit = _mm_set1_epi32(std::numeric_limits<int32_t>::min());
+    size_t index = begin;
+    for (; index + 4 <= end; index += 4) {
+        const __m128i candidate = _mm_add_epi32(weight_from_x4, _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights_through + index)));
+        const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights_row + index));
+        const __m128i is_better = _mm_cmplt_epi32(_mm_xor_si128(candidate, sign_bit), _mm_xor_si128(current, sign_bit));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(weights_row + index),
+                         _mm_or_si128(_mm_and_si128(is_better, candidate), _mm_andnot_si128(is_better, current)));
+
+        const __m128i prev_through = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_edges_through + index));
+        const __m128i prev_current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_edges_row + index));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(prev_edges_row + index),
+                         _mm_or_si128(_mm_and_si128(is_better, prev_through), _mm_andnot_si128(is_better, prev_current)));
+    }
+    RelaxRow<uint32_t, uint32_t>(weight_from, weights_through, prev_edges_through, weights_row, prev_edges_row, index, end);
+}
+#endif
+
+}  // namespace detail
+
+// Предрасчёт всех пар вершин в плотной построчной таблице.
+// Вместо vector<vector<optional<...>>> хранятся два плоских массива размера V*V:
+// веса в сжатом типе StoredWeight (float по умолчанию) и 32-битные номера последних рёбер пути.
+// Отсутствие пути обозначается бесконечным весом и NO_EDGE, а не optional.
+// StoredWeight - тип с бесконечностью (float) или беззнаковое целое (uint32_t) - фиксированная точка:
+// вес ребра умножается на масштаб - степень двойки, выбранную так, что путь из V - 1 рёбер
+// не дойдёт до 2^31, - и округляется. Сложение целых точное и не зависит от порядка, а релаксация
+// сводится к целочисленному min (AVX2/SSE4.1 при сборке с их поддержкой).
+// Вес найденного маршрута пересчитывается по исходным рёбрам графа, поэтому он точный при любом StoredWeight.
+// Флойд-Уоршелл выполняется поблочно: таблица делится на квадратные блоки BLOCK_SIZE x BLOCK_SIZE,
+// независимые блоки каждой фазы обрабатываются параллельно в пуле потоков.
+template <typename Weight, typename StoredWeight = float>
+class CompactRouter : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+    static constexpr bool IS_FIXED_POINT = std::is_integral_v<StoredWeight>;
+
+    static_assert(std::numeric_limits<StoredWeight>::has_infinity || (IS_FIXED_POINT && std::is_unsigned_v<StoredWeight>),
+                  "StoredWeight should have an infinity value or be an unsigned integer");
+
+public:
+    using typename RouterBase<Weight>::RouteInfo;
+    using EdgeIndex = uint32_t;
+
+    // Со своим пулом потоков; thread_count == 0 - по числу аппаратных потоков
+    explicit CompactRouter(const Graph& graph, size_t thread_count = 0);
+    // С общим пулом потоков, который должен жить дольше маршрутизатора
+    CompactRouter(const Graph& graph, util::ThreadPool& pool);
+    // Маршрутизатор над готовой таблицей размера V*V, построенной ранее для того же графа
+    // (например, отображённой в память из снимка). Таблица не копируется и должна жить дольше маршрутизатора.
+    // Строка проверяется при первом запросе из её вершины; ответы по повреждённой строке дают поиск Дейкстры.
+    // Без pool свой пул создаётся при первом вызове UpdateEdges.
+    CompactRouter(const Graph& graph, const StoredWeight* table_weights, const EdgeIndex* table_prev_edges,
+                  util::ThreadPool* pool = nullptr);
+
+    bool FillRoute(VertexId from, VertexId to, RouteInfo& route_info) const override;
+    // Пересчитывает поиском Дейкстры строки таблицы, которые изменение маски может затронуть, параллельно.
+    // Внешняя таблица (из снимка) при этом сначала копируется в собственную память, повреждённые строки пересчитываются.
+    void UpdateEdges(const std::vector<EdgeId>& edge_ids) override;
+
+    // Объём памяти, занимаемой таблицей, в байтах
+    size_t GetTableSize() const {
+        return EstimateMemory(vertex_count_);
+    }
+
+    // Память таблицы для графа из vertex_count вершин, в байтах
+    static size_t EstimateMemory(size_t vertex_count) {
+        return vertex_count * vertex_count * (sizeof(StoredWeight) + sizeof(EdgeIndex));
+    }
+
+    // Построчные массивы таблицы размера V*V
+    const StoredWeight* GetTableWeights() const {
+        return table_weights_;
+    }
+
+    const EdgeIndex* GetTablePrevEdges() const {
+        return table_prev_edges_;
+    }
+
+private:
+    static constexpr EdgeIndex NO_EDGE = std::numeric_limits<EdgeIndex>::max();
+    // для фиксированной точки - половина диапазона: сумма конечного веса и бесконечности не переполняется
+    static constexpr StoredWeight INFINITE_WEIGHT = IS_FIXED_POINT ? std::numeric_limits<StoredWeight>::max() / 2 + 1
+                                                                   : std::numeric_limits<StoredWeight>::infinity();
+    // наибольший масштаб фиксированной точки: 2^16 долей единицы веса
+    static constexpr double MAX_WEIGHT_SCALE = 65536.0;
+    // 64 x 64 ячеек: блоки весов и рёбер по 16 КБ, три блока фазы помещаются в L1/L2
+    static constexpr size_t BLOCK_SIZE = 64;
+    // состояния строк внешней таблицы
+    enum RowState : uint8_t { UNCHECKED_ROW, VALID_ROW, INVALID_ROW };
+
+    size_t GetIndex(VertexId from, VertexId to) const {
+        return from * vertex_count_ + to;
+    }
+
+    // Масштаб фиксированной точки: (V - 1) * (наибольший вес ребра * масштаб + 1) < INFINITE_WEIGHT,
+    // так что кратчайший путь с учётом округления каждого ребра остаётся конечным
+    double ComputeWeightScale() const {
+        double max_weight = 0.0;
+        for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+            max_weight = std::max(max_weight, static_cast<double>(graph_.GetEdge(edge_id).weight));
+        }
+        const double max_path_edge = static_cast<double>(INFINITE_WEIGHT) / std::max<size_t>(vertex_count_, 2) - 1.0;
+        if (max_weight == 0.0) {
+            return MAX_WEIGHT_SCALE;
+        }
+        if (!(max_path_edge > 0.0) || !std::isfinite(max_weight)) {
+            throw std::length_error("Edges' weights are too large for fixed-point routes table");
+        }
+        return std::min(MAX_WEIGHT_SCALE, std::exp2(std::floor(std::log2(max_path_edge / max_weight))));
+    }
+
+    StoredWeight ToStoredWeight(Weight weight, double weight_scale) const {
+        if constexpr (IS_FIXED_POINT) {
+            return static_cast<StoredWeight>(std::llround(static_cast<double>(weight) * weight_scale));
+        }
+        else {
+            return static_cast<StoredWeight>(weight);
+        }
+    }
+
+    void InitializeRoutesTable() {
+        weight_scale_ = IS_FIXED_POINT ? ComputeWeightScale() : 1.0;
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            weights_[GetIndex(vertex, vertex)] = StoredWeight{};
+            for (const auto& edge : graph_.GetOutgoingEdges(vertex)) {
+                const EdgeId edge_id = graph_.GetEdgeId(edge);
+                if (edge.weight < Weight{}) {
+                    throw std::domain_error("Edges' weights should be non-negative");
+                }
+                if (!graph_.IsEdgeEnabled(edge_id)) {
+                    continue;
+                }
+                const size_t index = GetIndex(vertex, edge.to);
+                const StoredWeight weight = ToStoredWeight(edge.weight, weight_scale_);
+                if (weight < weights_[index]) {
+                    weights_[index] = weight;
+                    prev_edges_[index] = static_cast<EdgeIndex>(edge_id);
+                }
+            }
+        }
+    }
+
+    // Релаксация ячеек [from_begin, from_end) x [to_begin, to_end) через вершины [through_begin, through_end)
+    void RelaxBlock(VertexId from_begin, VertexId from_end, VertexId to_begin, VertexId to_end,
+                    VertexId through_begin, VertexId through_end) {
+        for (VertexId vertex_through = through_begin; vertex_through < through_end; ++vertex_through) {
+            const StoredWeight* weights_through = &weights_[GetIndex(vertex_through, 0)];
+            const EdgeIndex* prev_edges_through = &prev_edges_[GetIndex(vertex_through, 0)];
+            for (VertexId vertex_from = from_begin; vertex_from < from_end; ++vertex_from) {
+                const StoredWeight weight_from = weights_[GetIndex(vertex_from, vertex_through)];
+                if (weight_from == INFINITE_WEIGHT) {
+                    continue;
+                }
+                detail::RelaxRow(weight_from, weights_through, prev_edges_through,
+                                 &weights_[GetIndex(vertex_from, 0)], &prev_edges_[GetIndex(vertex_from, 0)],
+                                 to_begin, to_end);
+            }
+        }
+    }
+
+    void RelaxRoutesTable(util::ThreadPool& pool) {
+        const size_t block_count = (vertex_count_ + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        const auto block_begin = [](size_t block) {
+            return block * BLOCK_SIZE;
+        };
+        const auto block_end = [this](size_t block) {
+            return std::min((block + 1) * BLOCK_SIZE, vertex_count_);
+        };
+
+        for (size_t through_block = 0; through_block < block_count; ++through_block) {
+            const VertexId through_begin = block_begin(through_block);
+            const VertexId through_end = block_end(through_block);
+
+            // Фаза 1: диагональный блок зависит только от себя
+            RelaxBlock(through_begin, through_end, through_begin, through_end, through_begin, through_end);
+
+            // Фаза 2: блоки той же строки и того же столбца зависят только от диагонального
+            pool.ParallelFor(block_count * 2, [&](size_t task) {
+                const size_t block = task / 2;
+                if (block == through_block) {
+                    return;
+                }
+                if (task % 2 == 0) {
+                    RelaxBlock(through_begin, through_end, block_begin(block), block_end(block), through_begin, through_end);
+                }
+                else {
+                    RelaxBlock(block_begin(block), block_end(block), through_begin, through_end, through_begin, through_end);
+                }
+            });
+
+            // Фаза 3: остальные блоки зависят только от блоков фазы 2, строки блоков обрабатываются независимо
+            pool.ParallelFor(block_count, [&](size_t from_block) {
+                if (from_block == through_block) {
+                    return;
+                }
+                for (size_t to_block = 0; to_block < block_count; ++to_block) {
+                    if (to_block != through_block) {
+                        RelaxBlock(block_begin(from_block), block_end(from_block), block_begin(to_block), block_end(to_block),
+                                   through_begin, through_end);
+                    }
+                }
+            });
+        }
+    }
+
+    // Строка from - дерево кратчайших путей из from. Отключённое ребро затрагивает строку, только если оно
+    // последнее на пути к своему концу, поэтому для отключённых рёбер достаточно проверить столбцы их различных
+    // концов disabled_ends; включённое ребро затрагивает строку, если сокращает путь до своего конца.
+    bool IsRowAffected(VertexId from, const std::vector<VertexId>& disabled_ends, const std::vector<EdgeId>& enabled_edges) const {
+        const StoredWeight* weights_row = &table_weights_[GetIndex(from, 0)];
+        const EdgeIndex* prev_edges_row = &table_prev_edges_[GetIndex(from, 0)];
+        for (const VertexId vertex : disabled_ends) {
+            const EdgeIndex prev_edge = prev_edges_row[vertex];
+            if (prev_edge != NO_EDGE && !graph_.IsEdgeEnabled(prev_edge)) {
+                return true;
+            }
+        }
+        for (const EdgeId edge_id : enabled_edges) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            if (weights_row[edge.from] != INFINITE_WEIGHT
+                && weights_row[edge.from] + ToStoredWeight(edge.weight, weight_scale_) < weights_row[edge.to]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Дейкстра на весах таблицы: вес каждого ребра переводится в StoredWeight и складывается в нём,
+    // как во Флойде-Уоршелле, поэтому в фиксированной точке пересчитанная строка совпадает с построенной
+    void RebuildRow(VertexId from) {
+        using SearchSpace = detail::SearchSpace<StoredWeight>;
+        SearchSpace& space = detail::GetSearchSpace<StoredWeight>(vertex_count_);
+        space.Relax(from, StoredWeight{}, SearchSpace::NO_EDGE);
+        while (!space.heap.empty()) {
+            const VertexId vertex = space.PopHeap().second;
+            if (space.settled[vertex]) {
+                continue;
+            }
+            space.settled[vertex] = 1;
+            const StoredWeight weight = space.weights[vertex];
+            for (const auto& edge : graph_.GetOutgoingEdges(vertex)) {
+                const EdgeId edge_id = graph_.GetEdgeId(edge);
+                if (graph_.IsEdgeEnabled(edge_id)) {
+                    space.Relax(edge.to, weight + ToStoredWeight(edge.weight, weight_scale_), edge_id);
+                }
+            }
+        }
+
+        StoredWeight* weights_row = &weights_[GetIndex(from, 0)];
+        EdgeIndex* prev_edges_row = &prev_edges_[GetIndex(from, 0)];
+        std::fill(weights_row, weights_row + vertex_count_, INFINITE_WEIGHT);
+        std::fill(prev_edges_row, prev_edges_row + vertex_count_, NO_EDGE);
+        for (const VertexId vertex : space.touched) {
+            const EdgeId prev_edge = space.prev_edges[vertex];
+            weights_row[vertex] = space.weights[vertex];
+            prev_edges_row[vertex] = prev_edge == SearchSpace::NO_EDGE ? NO_EDGE : static_cast<EdgeIndex>(prev_edge);
+        }
+    }
+
+    // Предшествующие рёбра строки должны образовывать дерево кратчайших путей с корнем from,
+    // иначе восстановление маршрута выйдет за границы таблицы или зациклится
+    bool IsRowTree(VertexId from) const {
+        const StoredWeight* weights_row = &table_weights_[GetIndex(from, 0)];
+        const EdgeIndex* prev_edges_row = &table_prev_edges_[GetIndex(from, 0)];
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            const EdgeIndex prev_edge = prev_edges_row[vertex];
+            if (!(weights_row[vertex] >= StoredWeight{})) {
+                return false;
+            }
+            if (vertex == from || prev_edge == NO_EDGE) {
+                // начальная вершина - без предшествующего ребра, недостижимая - с бесконечным весом
+                if (prev_edge != NO_EDGE || (vertex != from && weights_row[vertex] != INFINITE_WEIGHT)) {
+                    return false;
+                }
+            }
+            else if (prev_edge >= graph_.GetEdgeCount() || graph_.GetEdge(prev_edge).to != vertex
+                     || weights_row[vertex] == INFINITE_WEIGHT) {
+                return false;
+            }
+        }
+
+        // подъём по предшествующим рёбрам из каждой вершины должен дойти до from без циклов
+        enum : uint8_t { UNVISITED, ON_PATH, ON_TREE };
+        static thread_local std::vector<uint8_t> states;
+        static thread_local std::vector<VertexId> path;
+        states.assign(vertex_count_, UNVISITED);
+        states[from] = ON_TREE;
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            if (prev_edges_row[vertex] == NO_EDGE) {
+                continue;
+            }
+            path.clear();
+            VertexId current = vertex;
+            while (states[current] == UNVISITED) {
+                if (prev_edges_row[current] == NO_EDGE) {
+                    return false;
+                }
+                states[current] = ON_PATH;
+                path.push_back(current);
+                current = graph_.GetEdge(prev_edges_row[current]).from;
+            }
+            if (states[current] == ON_PATH) {
+                return false;
+            }
+            for (const VertexId path_vertex : path) {
+                states[path_vertex] = ON_TREE;
+            }
+        }
+        return true;
+    }
+
+    // Для собственной таблицы всегда true; строка внешней проверяется один раз.
+    // Одновременная проверка одной строки из разных потоков безвредна: результат тот же.
+    bool IsRowValid(VertexId from) const {
+        if (!row_states_) {
+            return true;
+        }
+        uint8_t state = row_states_[from].load(std::memory_order_acquire);
+        if (state == UNCHECKED_ROW) {
+            state = IsRowTree(from) ? VALID_ROW : INVALID_ROW;
+            row_states_[from].store(state, std::memory_order_release);
+        }
+        return state == VALID_ROW;
+    }
+
+    // Маршрут поиском Дейкстры - ответ по повреждённой строке внешней таблицы
+    bool FillSearchedRoute(VertexId from, VertexId to, RouteInfo& route_info) const {
+        using SearchSpace = detail::SearchSpace<Weight>;
+        SearchSpace& space = detail::GetSearchSpace<Weight>(vertex_count_);
+        detail::BuildShortestPathTree(graph_, space, from);
+        if (!space.settled[to]) {
+            return false;
+        }
+        route_info.weight = space.weights[to];
+        std::vector<EdgeId>& edges = route_info.edges;
+        edges.clear();
+        for (EdgeId edge_id = space.prev_edges[to]; edge_id != SearchSpace::NO_EDGE;
+             edge_id = space.prev_edges[graph_.GetEdge(edge_id).from])
+        {
+            edges.push_back(edge_id);
+        }
+        std::reverse(edges.begin(), edges.end());
+        return true;
+    }
+
+    void BuildRoutesTable();
+    util::ThreadPool& GetPool();
+
+    const Graph& graph_;
+    size_t vertex_count_;
+    std::unique_ptr<util::ThreadPool> own_pool_;
+    util::ThreadPool* pool_ = nullptr;  // own_pool_ или общий пул
+    double weight_scale_ = 1.0;  // для фиксированной точки; внешняя таблица бывает только с float
+    std::vector<StoredWeight> weights_;
+    std::vector<EdgeIndex> prev_edges_;
+    // Таблица, по которой отвечают запросы: собственные weights_ и prev_edges_ или внешняя память
+    const StoredWeight* table_weights_ = nullptr;
+    const EdgeIndex* table_prev_edges_ = nullptr;
+    // RowState по строкам внешней таблицы; nullptr - таблица собственная и построена здесь
+    std::unique_ptr<std::atomic<uint8_t>[]> row_states_;
+};
+
+template <typename Weight, typename StoredWeight>
+CompactRouter<Weight, StoredWeight>::CompactRouter(const Graph& graph, size_t thread_count)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+    , own_pool_(std::make_unique<util::ThreadPool>(thread_count))
+    , pool_(own_pool_.get())
+{
+    BuildRoutesTable();
+}
+
+template <typename Weight, typename StoredWeight>
+CompactRouter<Weight, StoredWeight>::CompactRouter(const Graph& graph, util::ThreadPool& pool)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+    , pool_(&pool)
+{
+    BuildRoutesTable();
+}
+
+template <typename Weight, typename StoredWeight>
+void CompactRouter<Weight, StoredWeight>::BuildRoutesTable() {
+    if (!graph_.IsFrozen()) {
+        throw std::invalid_argument("Graph should be frozen");
+    }
+    if (graph_.GetEdgeCount() >= NO_EDGE) {
+        throw std::length_error("Too many edges for compact routes table");
+    }
+
+    weights_.assign(vertex_count_ * vertex_count_, INFINITE_WEIGHT);
+    prev_edges_.assign(vertex_count_ * vertex_count_, NO_EDGE);
+    InitializeRoutesTable();
+    RelaxRoutesTable(*pool_);
+
+    table_weights_ = weights_.data();
+    table_prev_edges_ = prev_edges_.data();
+}
+
+template <typename Weight, typename StoredWeight>
+util::ThreadPool& CompactRouter<Weight, StoredWeight>::GetPool() {
+    if (pool_ == nullptr) {
+        own_pool_ = std::make_unique<util::ThreadPool>();
+        pool_ = own_pool_.get();
+    }
+    return *pool_;
+}
+
+template <typename Weight, typename StoredWeight>
+CompactRouter<Weight, StoredWeight>::CompactRouter(const Graph& graph, const StoredWeight* table_weights,
+                                                   const EdgeIndex* table_prev_edges, util::ThreadPool* pool)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+    , pool_(pool)
+    , table_weights_(table_weights)
+    , table_prev_edges_(table_prev_edges)
+    , row_states_(std::make_unique<std::atomic<uint8_t>[]>(vertex_count_))
+{
+    if (graph.GetEdgeCount() >= NO_EDGE) {
+        throw std::length_error("Too many edges for compact routes table");
+    }
+}
+
+template <typename Weight, typename StoredWeight>
+void CompactRouter<Weight, StoredWeight>::UpdateEdges(const std::vector<EdgeId>& edge_ids) {
+    if (edge_ids.empty()) {
+        return;
+    }
+    if (weights_.empty() && vertex_count_ > 0) {
+        weights_.assign(table_weights_, table_weights_ + vertex_count_ * vertex_count_);
+        prev_edges_.assign(table_prev_edges_, table_prev_edges_ + vertex_count_ * vertex_count_);
+        // копия и так читается целиком, поэтому здесь проверяются все ещё не проверенные строки;
+        // маска при этом уже новая, так что повреждённая строка сразу строится по ней
+        GetPool().ParallelFor(vertex_count_, [&](size_t from) {
+            if (!IsRowValid(from)) {
+                RebuildRow(from);
+            }
+        });
+        table_weights_ = weights_.data();
+        table_prev_edges_ = prev_edges_.data();
+        row_states_.reset();
+    }
+
+    std::vector<VertexId> disabled_ends;
+    std::vector<EdgeId> enabled_edges;
+    for (const EdgeId edge_id : edge_ids) {
+        if (graph_.IsEdgeEnabled(edge_id)) {
+            enabled_edges.push_back(edge_id);
+        }
+        else {
+            disabled_ends.push_back(graph_.GetEdge(edge_id).to);
+        }
+    }
+    // рёбра одного маршрута и одной остановки часто сходятся в одну вершину
+    std::sort(disabled_ends.begin(), disabled_ends.end());
+    disabled_ends.erase(std::unique(disabled_ends.begin(), disabled_ends.end()), disabled_ends.end());
+
+    // строки независимы: каждая читает и пишет только себя, рабочие массивы поиска - у каждого потока свои
+    GetPool().ParallelFor(vertex_count_, [&](size_t from) {
+        if (IsRowAffected(from, disabled_ends, enabled_edges)) {
+            RebuildRow(from);
+        }
+    });
+}
+
+template <typename Weight, typename StoredWeight>
+bool CompactRouter<Weight, StoredWeight>::FillRoute(VertexId from, VertexId to, RouteInfo& route_info) const {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    if (!IsRowValid(from)) {
+        return FillSearchedRoute(from, to, route_info);
+    }
+    if (table_weights_[GetIndex(from, to)] == INFINITE_WEIGHT) {
+        return false;
+    }
+
+    Weight weight{};
+    std::vector<EdgeId>& edges = route_info.edges;
+    edges.clear();
+    for (EdgeIndex edge_index = table_prev_edges_[GetIndex(from, to)];
+         edge_index != NO_EDGE;
+         edge_index = table_prev_edges_[GetIndex(from, graph_.GetEdge(edge_index).from)])
+    {
+        edges.push_back(edge_index);
+        weight += graph_.GetEdge(edge_index).weight;
+    }
+    std::reverse(edges.begin(), edges.end());
+    route_info.weight = weight;
+
+    return true;
+}
+
+}  // namespace graph
@@ -0,0 +1,793 @@
+#pragma once
+
+#include "dijkstra_router.h"
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+namespace detail {
+
+// Ребро иерархии: исходное ребро графа (номер совпадает с номером в графе)
+// или shortcut, заменяющий пару рёбер иерархии first_child -> second_child через стянутую вершину
+template <typename Weight>
+struct HierarchyEdge {
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+
+    VertexId from;
+    VertexId to;
+    Weight weight;
+    EdgeId first_child = NO_EDGE;
+    EdgeId second_child = NO_EDGE;
+
+    bool IsShortcut() const {
+        return first_child != NO_EDGE;
+    }
+};
+
+// Самые лёгкие рёбра между вершиной и соседями, для которых is_neighbor истинно: (сосед, номер ребра).
+// Рёбра edge_ids - входящие (is_incoming) или исходящие для вершины.
+template <typename Weight, typename NeighborPredicate>
+void CollectLightestNeighbors(const std::vector<HierarchyEdge<Weight>>& edges, const std::vector<EdgeId>& edge_ids,
+                              bool is_incoming, NeighborPredicate is_neighbor,
+                              std::vector<std::pair<VertexId, EdgeId>>& neighbors) {
+    neighbors.clear();
+    for (const EdgeId edge_id : edge_ids) {
+        const auto& edge = edges[edge_id];
+        const VertexId neighbor = is_incoming ? edge.from : edge.to;
+        if (is_neighbor(neighbor)) {
+            neighbors.emplace_back(neighbor, edge_id);
+        }
+    }
+    std::sort(neighbors.begin(), neighbors.end(), [&edges](const auto& lhs, const auto& rhs) {
+        return std::pair{lhs.first, edges[lhs.second].weight} < std::pair{rhs.first, edges[rhs.second].weight};
+    });
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first == rhs.first;
+    }), neighbors.end());
+}
+
+// Добавляет vertex в упорядоченный список без повторов
+inline void InsertSorted(std::vector<VertexId>& vertices, VertexId vertex) {
+    const auto it = std::lower_bound(vertices.begin(), vertices.end(), vertex);
+    if (it == vertices.end() || *it != vertex) {
+        vertices.insert(it, vertex);
+    }
+}
+
+// Записывает стягивание contracted_vertex в зависимости вершин пути свидетеля из source в target
+// (кроме target): path_parents - предыдущие вершины дерева поиска свидетелей
+inline void RecordWitnessPath(const std::vector<VertexId>& path_parents, VertexId source, VertexId target,
+                              VertexId contracted_vertex, std::vector<std::vector<VertexId>>& witness_users) {
+    for (VertexId vertex = target; vertex != source;) {
+        vertex = path_parents[vertex];
+        InsertSorted(witness_users[vertex], contracted_vertex);
+    }
+}
+
+// Стягивание вершин графа в порядке возрастания приоритета (edge difference + число стянутых соседей)
+// с ленивым пересчётом приоритетов и ограниченным поиском свидетелей
+template <typename Weight>
+class HierarchyContractor {
+public:
+    using Edges = std::vector<HierarchyEdge<Weight>>;
+
+    // Ограничение поиска свидетелей: если свидетель не найден за столько вершин, добавляется shortcut
+    static constexpr size_t WITNESS_SETTLED_LIMIT = 60;
+
+    HierarchyContractor(Edges& edges, size_t vertex_count)
+        : edges_(edges)
+        , outgoing_(vertex_count)
+        , incoming_(vertex_count)
+        , contracted_(vertex_count, 0)
+        , contracted_neighbors_(vertex_count, 0)
+        , witness_weights_(vertex_count, INFINITE_WEIGHT)
+        , witness_targets_(vertex_count, 0)
+        , witness_parents_(vertex_count)
+        , witness_users_(vertex_count)
+    {
+        for (EdgeId edge_id = 0; edge_id < edges_.size(); ++edge_id) {
+            const auto& edge = edges_[edge_id];
+            if (edge.from != edge.to) {
+                outgoing_[edge.from].push_back(edge_id);
+                incoming_[edge.to].push_back(edge_id);
+            }
+        }
+    }
+
+    // Возвращает ранги вершин: вершина с меньшим рангом стянута раньше
+    std::vector<size_t> Contract() {
+        const size_t vertex_count = outgoing_.size();
+        using QueueItem = std::pair<int64_t, VertexId>;
+        std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            queue.emplace(ComputePriority(vertex), vertex);
+        }
+
+        std::vector<size_t> ranks(vertex_count);
+        size_t next_rank = 0;
+        while (!queue.empty()) {
+            const VertexId vertex = queue.top().second;
+            queue.pop();
+            const int64_t priority = ComputePriority(vertex);
+            if (!queue.empty() && priority > queue.top().first) {
+                queue.emplace(priority, vertex);
+                continue;
+            }
+            ContractVertex(vertex, false);
+            contracted_[vertex] = 1;
+            ranks[vertex] = next_rank++;
+            DetachVertex(vertex);
+        }
+        return ranks;
+    }
+
+    // После Contract: по вершине - упорядоченный список вершин, при стягивании которых
+    // исходящее ребро вершины вошло в путь свидетеля
+    std::vector<std::vector<VertexId>> TakeWitnessUsers() {
+        return std::move(witness_users_);
+    }
+
+private:
+    static constexpr Weight INFINITE_WEIGHT = std::numeric_limits<Weight>::max();
+    // При оценке приоритета поиск свидетелей короче - точность там не нужна
+    static constexpr size_t SIMULATION_WITNESS_SETTLED_LIMIT = 15;
+
+    using HeapItem = std::pair<Weight, VertexId>;
+
+    int64_t ComputePriority(VertexId vertex) {
+        const int64_t shortcut_count = static_cast<int64_t>(ContractVertex(vertex, true));
+        int64_t removed_count = 0;
+        for (const EdgeId edge_id : outgoing_[vertex]) {
+            removed_count += contracted_[edges_[edge_id].to] ? 0 : 1;
+        }
+        for (const EdgeId edge_id : incoming_[vertex]) {
+            removed_count += contracted_[edges_[edge_id].from] ? 0 : 1;
+        }
+        return shortcut_count - removed_count + contracted_neighbors_[vertex];
+    }
+
+    // Самые лёгкие рёбра между vertex и ещё не стянутыми соседями: (сосед, номер ребра)
+    void CollectNeighbors(const std::vector<EdgeId>& edge_ids, bool is_incoming,
+                          std::vector<std::pair<VertexId, EdgeId>>& neighbors) const {
+        CollectLightestNeighbors(edges_, edge_ids, is_incoming, [this](VertexId neighbor) {
+            return !contracted_[neighbor];
+        }, neighbors);
+    }
+
+    // Стягивает вершину (или только считает нужные shortcut при simulate) и возвращает число shortcut
+    size_t ContractVertex(VertexId vertex, bool simulate) {
+        std::vector<std::pair<VertexId, EdgeId>> sources;
+        std::vector<std::pair<VertexId, EdgeId>> targets;
+        CollectNeighbors(incoming_[vertex], true, sources);
+        CollectNeighbors(outgoing_[vertex], false, targets);
+
+        for (const auto& [target, out_edge_id] : targets) {
+            witness_targets_[target] = 1;
+        }
+
+        size_t shortcut_count = 0;
+        for (const auto& [source, in_edge_id] : sources) {
+            const Weight in_weight = edges_[in_edge_id].weight;
+            Weight max_weight{};
+            for (const auto& [target, out_edge_id] : targets) {
+                if (target != source) {
+                    max_weight = std::max(max_weight, in_weight + edges_[out_edge_id].weight);
+                }
+            }
+            FindWitnesses(source, vertex, max_weight, targets.size(),
+                          simulate ? SIMULATION_WITNESS_SETTLED_LIMIT : WITNESS_SETTLED_LIMIT);
+
+            for (const auto& [target, out_edge_id] : targets) {
+                if (target == source) {
+                    continue;
+                }
+                const Weight weight = in_weight + edges_[out_edge_id].weight;
+                if (!(witness_weights_[target] <= weight)) {
+                    ++shortcut_count;
+                    if (!simulate) {
+                        AddShortcut(source, target, weight, in_edge_id, out_edge_id);
+                    }
+                }
+                else if (!simulate) {
+                    RecordWitnessPath(witness_parents_, source, target, vertex, witness_users_);
+                }
+            }
+        }
+
+        for (const auto& [target, out_edge_id] : targets) {
+            witness_targets_[target] = 0;
+        }
+        return shortcut_count;
+    }
+
+    // Добавляет shortcut; более тяжёлое параллельное ребро исключается из оставшегося графа
+    void AddShortcut(VertexId from, VertexId to, Weight weight, EdgeId first_child, EdgeId second_child) {
+        const EdgeId edge_id = edges_.size();
+        edges_.push_back({from, to, weight, first_child, second_child});
+
+        std::vector<EdgeId>& outgoing = outgoing_[from];
+        const auto parallel_it = std::find_if(outgoing.begin(), outgoing.end(), [this, to](EdgeId id) {
+            return edges_[id].to == to;
+        });
+        if (parallel_it != outgoing.end()) {
+            RemoveEdgeId(incoming_[to], *parallel_it);
+            outgoing.erase(parallel_it);
+        }
+        outgoing.push_back(edge_id);
+        incoming_[to].push_back(edge_id);
+    }
+
+    static void RemoveEdgeId(std::vector<EdgeId>& edge_ids, EdgeId edge_id) {
+        edge_ids.erase(std::remove(edge_ids.begin(), edge_ids.end(), edge_id), edge_ids.end());
+    }
+
+    // Убирает рёбра стянутой вершины из списков соседей, чтобы поиски свидетелей их не просматривали
+    void DetachVertex(VertexId vertex) {
+        for (const EdgeId edge_id : outgoing_[vertex]) {
+            const VertexId neighbor = edges_[edge_id].to;
+            RemoveEdgeId(incoming_[neighbor], edge_id);
+            ++contracted_neighbors_[neighbor];
+        }
+        for (const EdgeId edge_id : incoming_[vertex]) {
+            const VertexId neighbor = edges_[edge_id].from;
+            RemoveEdgeId(outgoing_[neighbor], edge_id);
+            ++contracted_neighbors_[neighbor];
+        }
+        outgoing_[vertex].clear();
+        outgoing_[vertex].shrink_to_fit();
+        incoming_[vertex].clear();
+        incoming_[vertex].shrink_to_fit();
+    }
+
+    // Ограниченный Дейкстра из source по нестянутым вершинам в обход excluded.
+    // Останавливается, когда извлечены все target_count помеченных вершин-целей.
+    void FindWitnesses(VertexId source, VertexId excluded, Weight max_weight, size_t target_count, size_t settled_limit) {
+        for (const VertexId vertex : witness_touched_) {
+            witness_weights_[vertex] = INFINITE_WEIGHT;
+        }
+        witness_touched_.clear();
+        witness_heap_.clear();
+
+        witness_weights_[source] = Weight{};
+        witness_touched_.push_back(source);
+        witness_heap_.emplace_back(Weight{}, source);
+
+        size_t settled_count = 0;
+        while (!witness_heap_.empty() && settled_count < settled_limit && target_count > 0) {
+            std::pop_heap(witness_heap_.begin(), witness_heap_.end(), std::greater<HeapItem>{});
+            const auto [weight, vertex] = witness_heap_.back();
+            witness_heap_.pop_back();
+            if (weight > witness_weights_[vertex]) {
+                continue;
+            }
+            if (weight > max_weight) {
+                break;
+            }
+            ++settled_count;
+            if (witness_targets_[vertex]) {
+                --target_count;
+            }
+            for (const EdgeId edge_id : outgoing_[vertex]) {
+                const auto& edge = edges_[edge_id];
+                if (edge.to == excluded || contracted_[edge.to]) {
+                    continue;
+                }
+                const Weight candidate_weight = weight + edge.weight;
+                if (candidate_weight < witness_weights_[edge.to]) {
+                    if (witness_weights_[edge.to] == INFINITE_WEIGHT) {
+                        witness_touched_.push_back(edge.to);
+                    }
+                    witness_weights_[edge.to] = candidate_weight;
+                    witness_parents_[edge.to] = vertex;
+                    witness_heap_.emplace_back(candidate_weight, edge.to);
+                    std::push_heap(witness_heap_.begin(), witness_heap_.end(), std::greater<HeapItem>{});
+                }
+            }
+        }
+    }
+
+    Edges& edges_;
+    std::vector<std::vector<EdgeId>> outgoing_;
+    std::vector<std::vector<EdgeId>> incoming_;
+    std::vector<char> contracted_;
+    std::vector<int64_t> contracted_neighbors_;
+
+    std::vector<Weight> witness_weights_;
+    std::vector<char> witness_targets_;
+    std::vector<VertexId> witness_touched_;
+    std::vector<HeapItem> witness_heap_;
+    std::vector<VertexId> witness_parents_;
+    std::vector<std::vector<VertexId>> witness_users_;
+};
+
+}  // namespace detail
+
+// Иерархия сжатия (Contraction Hierarchies): граф дополняется shortcut-рёбрами при стягивании вершин,
+// запрос - двунаправленный Дейкстра только по рёбрам, ведущим к вершинам большего ранга.
+// Shortcut помнит пару заменяемых рёбер, поэтому маршрут раскрывается до исходных рёбер графа.
+template <typename Weight>
+class ContractionHierarchy : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using typename RouterBase<Weight>::RouteInfo;
+
+    explicit ContractionHierarchy(const Graph& graph);
+
+    bool FillRoute(VertexId from, VertexId to, RouteInfo& route_info) const override;
+    // Порядок стягивания сохраняется, перестягиваются по возрастанию ранга только вершины, которые зависят
+    // от изменённых рёбер: их нижние концы и вершины, в пути свидетелей которых входило отключённое ребро.
+    // Изменённые при этом shortcut-рёбра так же задевают вершины выше, пока изменения не прекратятся.
+    void UpdateEdges(const std::vector<EdgeId>& edge_ids) override;
+
+    size_t GetShortcutCount() const {
+        return edges_.size() - original_edge_count_ - free_edge_ids_.size();
+    }
+
+    // Оценка памяти иерархии в байтах в предположении, что shortcut-рёбер не больше, чем исходных
+    // (на дорожных и транспортных графах их обычно меньше), а пути свидетелей при стягивании вершины
+    // проходят не больше чем через WITNESS_SETTLED_LIMIT вершин
+    static size_t EstimateMemory(size_t vertex_count, size_t edge_count) {
+        const size_t hierarchy_edge_count = edge_count * 2;
+        return hierarchy_edge_count * (sizeof(HierarchyEdge) + 2 * sizeof(EdgeId))
+               + vertex_count * (sizeof(size_t) + 5 * sizeof(std::vector<EdgeId>)
+                                 + detail::HierarchyContractor<Weight>::WITNESS_SETTLED_LIMIT * sizeof(VertexId));
+    }
+
+private:
+    using HierarchyEdge = detail::HierarchyEdge<Weight>;
+    using SearchSpace = detail::SearchSpace<Weight>;
+
+    // Раскрывает ребро иерархии в последовательность исходных рёбер
+    // stack - рабочий массив, переиспользуемый между вызовами
+    void UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& stack, std::vector<EdgeId>& edges) const {
+        stack.assign(1, edge_id);
+        while (!stack.empty()) {
+            const EdgeId current_id = stack.back();
+            stack.pop_back();
+            const HierarchyEdge& edge = edges_[current_id];
+            if (edge.IsShortcut()) {
+                stack.push_back(edge.second_child);
+                stack.push_back(edge.first_child);
+            }
+            else {
+                edges.push_back(current_id);
+            }
+        }
+    }
+
+    // Шаг поиска в одном направлении; обновляет лучший вес через вершину встречи.
+    // Возвращает true, если вершина извлечена впервые.
+    bool SearchStep(SearchSpace& space, const SearchSpace& other_space,
+                    const std::vector<std::vector<EdgeId>>& adjacency, bool is_forward,
+                    Weight& best_weight, VertexId& meeting_vertex) const {
+        const auto [weight, vertex] = space.PopHeap();
+        if (space.settled[vertex]) {
+            return false;
+        }
+        space.settled[vertex] = 1;
+
+        if (vertex < other_space.weights.size() && other_space.weights[vertex] != SearchSpace::INFINITE_WEIGHT) {
+            const Weight total_weight = weight + other_space.weights[vertex];
+            if (total_weight < best_weight) {
+                best_weight = total_weight;
+                meeting_vertex = vertex;
+            }
+        }
+
+        for (const EdgeId edge_id : adjacency[vertex]) {
+            const HierarchyEdge& edge = edges_[edge_id];
+            space.Relax(is_forward ? edge.to : edge.from, weight + edge.weight, edge_id);
+        }
+        return true;
+    }
+
+    // Ребро живое, если включено в графе (исходное) или заменяет путь из живых рёбер (shortcut);
+    // отключённые и удалённые рёбра хранятся петлями
+    static bool IsLive(const HierarchyEdge& edge) {
+        return edge.from != edge.to;
+    }
+
+    VertexId GetLowerVertex(const HierarchyEdge& edge) const {
+        return ranks_[edge.from] < ranks_[edge.to] ? edge.from : edge.to;
+    }
+
+    // Ранг, с которого ребро есть в стягиваемом графе: 0 у исходного, у shortcut - следующий
+    // за рангом стянутой вершины (второе ребро выходит из неё, а начало ребра не меняется и у удалённого)
+    size_t GetAppearanceRank(const HierarchyEdge& edge) const {
+        return edge.IsShortcut() ? ranks_[edges_[edge.second_child].from] + 1 : 0;
+    }
+
+    void AttachEdge(EdgeId edge_id);
+    void DetachEdge(EdgeId edge_id);
+    void ScheduleContraction(VertexId vertex);
+    void ScheduleEdgeRemoval(EdgeId edge_id);
+    EdgeId AddShortcut(VertexId from, VertexId to, Weight weight, EdgeId first_child, EdgeId second_child);
+    void FindWitnesses(VertexId source, VertexId excluded, Weight max_weight, size_t target_count);
+    void Recontract(VertexId vertex);
+    void Build();
+
+    const Graph& graph_;
+    size_t original_edge_count_ = 0;
+    std::vector<HierarchyEdge> edges_;
+    std::vector<size_t> ranks_;
+    std::vector<std::vector<EdgeId>> upward_edges_;    // из вершины в вершины большего ранга
+    std::vector<std::vector<EdgeId>> downward_edges_;  // в вершину из вершин большего ранга
+
+    // Для UpdateEdges
+    std::vector<std::vector<EdgeId>> downward_out_edges_;  // из вершины в вершины меньшего ранга
+    std::vector<std::vector<EdgeId>> vertex_shortcuts_;    // shortcut-рёбра, добавленные стягиванием вершины
+    // по вершине - вершины, в путь свидетеля при стягивании которых вошло её исходящее ребро;
+    // после перестягивания устаревшие записи остаются и только добавляют проверок
+    std::vector<std::vector<VertexId>> witness_users_;
+    std::vector<EdgeId> free_edge_ids_;  // номера удалённых shortcut-рёбер для новых
+    // удалённые в текущем UpdateEdges: на них ещё могут ссылаться shortcut-рёбра, которые удалятся позже
+    std::vector<EdgeId> removed_edge_ids_;
+    std::priority_queue<std::pair<size_t, VertexId>, std::vector<std::pair<size_t, VertexId>>,
+                        std::greater<std::pair<size_t, VertexId>>> contraction_queue_;  // (ранг, вершина)
+    std::vector<char> is_scheduled_;
+    std::vector<Weight> witness_weights_;
+    std::vector<char> witness_targets_;
+    std::vector<VertexId> witness_touched_;
+    std::vector<std::pair<Weight, VertexId>> witness_heap_;
+    std::vector<VertexId> witness_parents_;
+};
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(const Graph& graph)
+    : graph_(graph)
+{
+    Build();
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::UpdateEdges(const std::vector<EdgeId>& edge_ids) {
+    for (const EdgeId edge_id : edge_ids) {
+        const auto& graph_edge = graph_.GetEdge(edge_id);
+        if (graph_edge.from == graph_edge.to || graph_.IsEdgeEnabled(edge_id) == IsLive(edges_[edge_id])) {
+            continue;
+        }
+        if (graph_.IsEdgeEnabled(edge_id)) {
+            // новое ребро меняет только пары рёбер своего нижнего конца: свидетели у других вершин
+            // становятся короче, а лишний shortcut не нарушает иерархию
+            edges_[edge_id].to = graph_edge.to;
+            AttachEdge(edge_id);
+            ScheduleContraction(GetLowerVertex(edges_[edge_id]));
+        }
+        else {
+            ScheduleEdgeRemoval(edge_id);
+            DetachEdge(edge_id);
+        }
+    }
+
+    // перестягивание вершины меняет только рёбра между вершинами большего ранга,
+    // поэтому каждая вершина перестягивается не больше одного раза
+    while (!contraction_queue_.empty()) {
+        const VertexId vertex = contraction_queue_.top().second;
+        contraction_queue_.pop();
+        is_scheduled_[vertex] = 0;
+        Recontract(vertex);
+    }
+    free_edge_ids_.insert(free_edge_ids_.end(), removed_edge_ids_.begin(), removed_edge_ids_.end());
+    removed_edge_ids_.clear();
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::AttachEdge(EdgeId edge_id) {
+    const HierarchyEdge& edge = edges_[edge_id];
+    if (ranks_[edge.from] < ranks_[edge.to]) {
+        upward_edges_[edge.from].push_back(edge_id);
+    }
+    else {
+        downward_edges_[edge.to].push_back(edge_id);
+        downward_out_edges_[edge.from].push_back(edge_id);
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::DetachEdge(EdgeId edge_id) {
+    HierarchyEdge& edge = edges_[edge_id];
+    const auto remove_edge_id = [edge_id](std::vector<EdgeId>& edge_ids) {
+        edge_ids.erase(std::find(edge_ids.begin(), edge_ids.end(), edge_id));
+    };
+    if (ranks_[edge.from] < ranks_[edge.to]) {
+        remove_edge_id(upward_edges_[edge.from]);
+    }
+    else {
+        remove_edge_id(downward_edges_[edge.to]);
+        remove_edge_id(downward_out_edges_[edge.from]);
+    }
+    edge.to = edge.from;
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::ScheduleContraction(VertexId vertex) {
+    if (!is_scheduled_[vertex]) {
+        is_scheduled_[vertex] = 1;
+        contraction_queue_.emplace(ranks_[vertex], vertex);
+    }
+}
+
+// Вызывается для ещё живого ребра перед его удалением
+template <typename Weight>
+void ContractionHierarchy<Weight>::ScheduleEdgeRemoval(EdgeId edge_id) {
+    const HierarchyEdge& edge = edges_[edge_id];
+    ScheduleContraction(GetLowerVertex(edge));
+    // ребро могло быть частью свидетеля вершины ниже обоих концов, стянутой, когда ребро уже было
+    const size_t end_rank = std::min(ranks_[edge.from], ranks_[edge.to]);
+    const size_t appearance_rank = GetAppearanceRank(edge);
+    for (const VertexId vertex : witness_users_[edge.from]) {
+        if (ranks_[vertex] < end_rank && ranks_[vertex] >= appearance_rank) {
+            ScheduleContraction(vertex);
+        }
+    }
+}
+
+template <typename Weight>
+EdgeId ContractionHierarchy<Weight>::AddShortcut(VertexId from, VertexId to, Weight weight, EdgeId first_child, EdgeId second_child) {
+    EdgeId edge_id = edges_.size();
+    if (free_edge_ids_.empty()) {
+        edges_.push_back({from, to, weight, first_child, second_child});
+    }
+    else {
+        edge_id = free_edge_ids_.back();
+        free_edge_ids_.pop_back();
+        edges_[edge_id] = {from, to, weight, first_child, second_child};
+    }
+    AttachEdge(edge_id);
+    return edge_id;
+}
+
+// Ограниченный Дейкстра из source по вершинам ранга выше excluded и рёбрам, которые были
+// в графе при стягивании excluded, - как при построении
+template <typename Weight>
+void ContractionHierarchy<Weight>::FindWitnesses(VertexId source, VertexId excluded, Weight max_weight, size_t target_count) {
+    for (const VertexId vertex : witness_touched_) {
+        witness_weights_[vertex] = SearchSpace::INFINITE_WEIGHT;
+    }
+    witness_touched_.clear();
+    witness_heap_.clear();
+
+    const size_t excluded_rank = ranks_[excluded];
+    witness_weights_[source] = Weight{};
+    witness_touched_.push_back(source);
+    witness_heap_.emplace_back(Weight{}, source);
+
+    size_t settled_count = 0;
+    while (!witness_heap_.empty() && settled_count < detail::HierarchyContractor<Weight>::WITNESS_SETTLED_LIMIT && target_count > 0) {
+        std::pop_heap(witness_heap_.begin(), witness_heap_.end(), std::greater<>{});
+        const auto [weight, vertex] = witness_heap_.back();
+        witness_heap_.pop_back();
+        if (weight > witness_weights_[vertex]) {
+            continue;
+        }
+        if (weight > max_weight) {
+            break;
+        }
+        ++settled_count;
+        if (witness_targets_[vertex]) {
+            --target_count;
+        }
+        for (const auto* edge_ids : {&upward_edges_[vertex], &downward_out_edges_[vertex]}) {
+            for (const EdgeId edge_id : *edge_ids) {
+                const HierarchyEdge& edge = edges_[edge_id];
+                if (edge.to == excluded || ranks_[edge.to] < excluded_rank || GetAppearanceRank(edge) > excluded_rank) {
+                    continue;
+                }
+                const Weight candidate_weight = weight + edge.weight;
+                if (candidate_weight < witness_weights_[edge.to]) {
+                    if (witness_weights_[edge.to] == SearchSpace::INFINITE_WEIGHT) {
+                        witness_touched_.push_back(edge.to);
+                    }
+                    witness_weights_[edge.to] = candidate_weight;
+                    witness_parents_[edge.to] = vertex;
+                    witness_heap_.emplace_back(candidate_weight, edge.to);
+                    std::push_heap(witness_heap_.begin(), witness_heap_.end(), std::greater<>{});
+                }
+            }
+        }
+    }
+}
+
+// Стягивает вершину заново по текущим рёбрам к вершинам большего ранга, как Contract при построении.
+// Прежний shortcut с теми же концами остаётся под своим номером с новыми весом и дочерними рёбрами,
+// ненужные удаляются.
+template <typename Weight>
+void ContractionHierarchy<Weight>::Recontract(VertexId vertex) {
+    const auto is_any = [](VertexId) {
+        return true;
+    };
+    std::vector<std::pair<VertexId, EdgeId>> sources;
+    std::vector<std::pair<VertexId, EdgeId>> targets;
+    detail::CollectLightestNeighbors(edges_, downward_edges_[vertex], true, is_any, sources);
+    detail::CollectLightestNeighbors(edges_, upward_edges_[vertex], false, is_any, targets);
+
+    // у вершины не больше одного shortcut на пару концов
+    std::vector<EdgeId> old_shortcuts = std::move(vertex_shortcuts_[vertex]);
+    const auto ends_less = [this](EdgeId lhs, EdgeId rhs) {
+        return std::pair{edges_[lhs].from, edges_[lhs].to} < std::pair{edges_[rhs].from, edges_[rhs].to};
+    };
+    std::sort(old_shortcuts.begin(), old_shortcuts.end(), ends_less);
+    std::vector<char> is_kept(old_shortcuts.size(), 0);
+    std::vector<EdgeId>& shortcuts = vertex_shortcuts_[vertex];
+    shortcuts.clear();
+
+    for (const auto& [target, out_edge_id] : targets) {
+        witness_targets_[target] = 1;
+    }
+    std::vector<std::tuple<VertexId, VertexId, Weight, EdgeId, EdgeId>> new_shortcuts;
+    for (const auto& [source, in_edge_id] : sources) {
+        const Weight in_weight = edges_[in_edge_id].weight;
+        Weight max_weight{};
+        for (const auto& [target, out_edge_id] : targets) {
+            if (target != source) {
+                max_weight = std::max(max_weight, in_weight + edges_[out_edge_id].weight);
+            }
+        }
+        FindWitnesses(source, vertex, max_weight, targets.size());
+
+        for (const auto& [target, out_edge_id] : targets) {
+            if (target == source) {
+                continue;
+            }
+            const Weight weight = in_weight + edges_[out_edge_id].weight;
+            if (witness_weights_[target] <= weight) {
+                detail::RecordWitnessPath(witness_parents_, source, target, vertex, witness_users_);
+                continue;
+            }
+            const auto old_it = std::lower_bound(old_shortcuts.begin(), old_shortcuts.end(), source,
+                                                 [this, target = target](EdgeId edge_id, VertexId from) {
+                return std::pair{edges_[edge_id].from, edges_[edge_id].to} < std::pair{from, target};
+            });
+            if (old_it == old_shortcuts.end() || edges_[*old_it].from != source || edges_[*old_it].to != target) {
+                new_shortcuts.emplace_back(source, target, weight, in_edge_id, out_edge_id);
+                continue;
+            }
+            // более лёгкий shortcut меняет только пары рёбер нижнего конца, более тяжёлый - ещё и свидетелей
+            HierarchyEdge& edge = edges_[*old_it];
+            if (edge.weight < weight) {
+                ScheduleEdgeRemoval(*old_it);
+            }
+            else if (weight < edge.weight) {
+                ScheduleContraction(GetLowerVertex(edge));
+            }
+            edge.weight = weight;
+            edge.first_child = in_edge_id;
+            edge.second_child = out_edge_id;
+            is_kept[old_it - old_shortcuts.begin()] = 1;
+            shortcuts.push_back(*old_it);
+        }
+    }
+    for (const auto& [target, out_edge_id] : targets) {
+        witness_targets_[target] = 0;
+    }
+
+    for (size_t i = 0; i < old_shortcuts.size(); ++i) {
+        if (is_kept[i]) {
+            continue;
+        }
+        const EdgeId edge_id = old_shortcuts[i];
+        ScheduleEdgeRemoval(edge_id);
+        DetachEdge(edge_id);
+        removed_edge_ids_.push_back(edge_id);
+    }
+    for (const auto& [source, target, weight, in_edge_id, out_edge_id] : new_shortcuts) {
+        const EdgeId edge_id = AddShortcut(source, target, weight, in_edge_id, out_edge_id);
+        shortcuts.push_back(edge_id);
+        ScheduleContraction(GetLowerVertex(edges_[edge_id]));
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::Build() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    original_edge_count_ = graph_.GetEdgeCount();
+    edges_.clear();
+    upward_edges_.assign(vertex_count, {});
+    downward_edges_.assign(vertex_count, {});
+    downward_out_edges_.assign(vertex_count, {});
+    vertex_shortcuts_.assign(vertex_count, {});
+    is_scheduled_.assign(vertex_count, 0);
+    witness_weights_.assign(vertex_count, SearchSpace::INFINITE_WEIGHT);
+    witness_targets_.assign(vertex_count, 0);
+    witness_parents_.assign(vertex_count, 0);
+
+    edges_.reserve(original_edge_count_);
+    for (EdgeId edge_id = 0; edge_id < original_edge_count_; ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        if (edge.weight < Weight{}) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        // отключённое ребро остаётся под своим номером петлёй: петли не участвуют ни в стягивании, ни в запросах
+        edges_.push_back({edge.from, graph_.IsEdgeEnabled(edge_id) ? edge.to : edge.from, edge.weight});
+    }
+
+    detail::HierarchyContractor<Weight> contractor{edges_, vertex_count};
+    ranks_ = contractor.Contract();
+    witness_users_ = contractor.TakeWitnessUsers();
+
+    for (EdgeId edge_id = 0; edge_id < edges_.size(); ++edge_id) {
+        const HierarchyEdge& edge = edges_[edge_id];
+        if (!IsLive(edge)) {
+            continue;
+        }
+        AttachEdge(edge_id);
+        if (edge.IsShortcut()) {
+            vertex_shortcuts_[edges_[edge.first_child].to].push_back(edge_id);
+        }
+    }
+}
+
+template <typename Weight>
+bool ContractionHierarchy<Weight>::FillRoute(VertexId from, VertexId to, RouteInfo& route_info) const {
+    const size_t vertex_count = ranks_.size();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    SearchSpace& forward = detail::GetSearchSpace<Weight>(vertex_count, 0);
+    SearchSpace& backward = detail::GetSearchSpace<Weight>(vertex_count, 1);
+    forward.Relax(from, Weight{}, SearchSpace::NO_EDGE);
+    backward.Relax(to, Weight{}, SearchSpace::NO_EDGE);
+
+    Weight best_weight = SearchSpace::INFINITE_WEIGHT;
+    VertexId meeting_vertex = vertex_count;
+    size_t settled_count = 0;
+    while (true) {
+        // Направление заканчивается, когда минимум его кучи не меньше лучшего найденного веса
+        const bool forward_active = !forward.heap.empty() && forward.heap.front().first < best_weight;
+        const bool backward_active = !backward.heap.empty() && backward.heap.front().first < best_weight;
+        if (!forward_active && !backward_active) {
+            break;
+        }
+        if (forward_active && (!backward_active || forward.heap.front().first <= backward.heap.front().first)) {
+            settled_count += SearchStep(forward, backward, upward_edges_, true, best_weight, meeting_vertex);
+        }
+        else {
+            settled_count += SearchStep(backward, forward, downward_edges_, false, best_weight, meeting_vertex);
+        }
+    }
+    this->AddSettledVertices(settled_count);
+
+    if (meeting_vertex == vertex_count) {
+        return false;
+    }
+
+    // рабочие массивы рёбер берутся из пространств поиска, чтобы не выделять память на запрос
+    std::vector<EdgeId>& hierarchy_edges = forward.scratch_edges;
+    hierarchy_edges.clear();
+    for (EdgeId edge_id = forward.prev_edges[meeting_vertex]; edge_id != SearchSpace::NO_EDGE;
+         edge_id = forward.prev_edges[edges_[edge_id].from])
+    {
+        hierarchy_edges.push_back(edge_id);
+    }
+    std::reverse(hierarchy_edges.begin(), hierarchy_edges.end());
+    for (EdgeId edge_id = backward.prev_edges[meeting_vertex]; edge_id != SearchSpace::NO_EDGE;
+         edge_id = backward.prev_edges[edges_[edge_id].to])
+    {
+        hierarchy_edges.push_back(edge_id);
+    }
+
+    route_info.weight = best_weight;
+    route_info.edges.clear();
+    for (const EdgeId edge_id : hierarchy_edges) {
+        UnpackEdge(edge_id, backward.scratch_edges, route_info.edges);
+    }
+
+    return true;
+}
+
+}  // namespace graph
@@ -0,0 +1,438 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "search_space.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+namespace detail {
+
+// Дейкстра из from до извлечения из кучи всех вершин targets (или исчерпания кучи).
+// Возвращает число извлечённых вершин.
+template <typename Weight>
+size_t SearchTree(const DirectedWeightedGraph<Weight>& graph, SearchSpace<Weight>& space, VertexId from,
+                  const std::vector<VertexId>& targets) {
+    // вершины-цели помечаются в settled заранее значением 2, чтобы считать оставшиеся без поиска по targets
+    size_t remaining_count = 0;
+    for (const VertexId to : targets) {
+        if (to >= graph.GetVertexCount()) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        if (space.settled[to] == 0) {
+            space.settled[to] = 2;
+            space.touched.push_back(to);
+            ++remaining_count;
+        }
+    }
+
+    space.Relax(from, Weight{}, SearchSpace<Weight>::NO_EDGE);
+    size_t settled_count = 0;
+    while (remaining_count > 0 && !space.heap.empty()) {
+        const VertexId vertex = space.PopHeap().second;
+        if (space.settled[vertex] == 1) {
+            continue;
+        }
+        remaining_count -= space.settled[vertex] == 2;
+        space.settled[vertex] = 1;
+        ++settled_count;
+        const Weight weight = space.weights[vertex];
+        for (const auto& edge : graph.GetOutgoingEdges(vertex)) {
+            const EdgeId edge_id = graph.GetEdgeId(edge);
+            const Weight candidate_weight = weight + edge.weight;
+            if (graph.IsEdgeEnabled(edge_id) && candidate_weight < space.weights[edge.to]) {
+                space.Relax(edge.to, candidate_weight, edge_id);
+            }
+        }
+    }
+    return settled_count;
+}
+
+// Маршруты до вершин targets по дереву, построенному SearchTree
+template <typename Weight>
+std::vector<std::optional<typename RouterBase<Weight>::RouteInfo>> ExtractRoutes(const DirectedWeightedGraph<Weight>& graph,
+                                                                                 const SearchSpace<Weight>& space,
+                                                                                 const std::vector<VertexId>& targets) {
+    std::vector<std::optional<typename RouterBase<Weight>::RouteInfo>> routes;
+    routes.reserve(targets.size());
+    for (const VertexId to : targets) {
+        if (space.settled[to] != 1) {
+            routes.emplace_back(std::nullopt);
+            continue;
+        }
+        std::vector<EdgeId> edges;
+        for (EdgeId edge_id = space.prev_edges[to]; edge_id != SearchSpace<Weight>::NO_EDGE;
+             edge_id = space.prev_edges[graph.GetEdge(edge_id).from])
+        {
+            edges.push_back(edge_id);
+        }
+        std::reverse(edges.begin(), edges.end());
+        routes.push_back(typename RouterBase<Weight>::RouteInfo{space.weights[to], std::move(edges)});
+    }
+    return routes;
+}
+
+}  // namespace detail
+
+// Поиск кратчайшего пути по запросу (Дейкстра на двоичной куче) без предрасчёта всех пар.
+// Поиск прекращается, как только вершина назначения извлечена из кучи.
+// С эвристикой - нижней оценкой веса пути от вершины до цели - поиск работает как A*.
+// Эвристика должна быть согласованной: h(u) <= w(u, v) + h(v) для каждого ребра u -> v.
+template <typename Weight>
+class DijkstraRouter : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using typename RouterBase<Weight>::RouteInfo;
+    using Heuristic = std::function<Weight(VertexId vertex, VertexId to)>;
+
+    explicit DijkstraRouter(const Graph& graph, Heuristic heuristic = {});
+
+    bool FillRoute(VertexId from, VertexId to, RouteInfo& route_info) const override;
+
+    // Предрасчёта нет: память рабочих массивов поиска одного потока, в байтах
+    static size_t EstimateMemory(size_t vertex_count) {
+        return vertex_count * (sizeof(Weight) + sizeof(EdgeId) + sizeof(char) + sizeof(VertexId));
+    }
+    // Одно дерево кратчайших путей на все цели; эвристика A* при этом не используется
+    std::vector<std::optional<RouteInfo>> BuildRoutes(VertexId from, const std::vector<VertexId>& targets) const override;
+
+private:
+    using SearchSpace = detail::SearchSpace<Weight>;
+
+    Weight GetKey(Weight weight, VertexId vertex, VertexId to) const {
+        return heuristic_ ? weight + heuristic_(vertex, to) : weight;
+    }
+
+    // Возвращает число извлечённых из кучи вершин
+    size_t Search(SearchSpace& space, VertexId from, VertexId to) const {
+        space.Relax(from, ZERO_WEIGHT, SearchSpace::NO_EDGE, GetKey(ZERO_WEIGHT, from, to));
+
+        size_t settled_count = 0;
+        while (!space.heap.empty()) {
+            const VertexId vertex = space.PopHeap().second;
+            if (space.settled[vertex]) {
+                continue;
+            }
+            space.settled[vertex] = 1;
+            ++settled_count;
+            if (vertex == to) {
+                break;
+            }
+            const Weight weight = space.weights[vertex];
+            for (const auto& edge : graph_.GetOutgoingEdges(vertex)) {
+                const EdgeId edge_id = graph_.GetEdgeId(edge);
+                const Weight candidate_weight = weight + edge.weight;
+                if (graph_.IsEdgeEnabled(edge_id) && candidate_weight < space.weights[edge.to]) {
+                    space.Relax(edge.to, candidate_weight, edge_id, GetKey(candidate_weight, edge.to, to));
+                }
+            }
+        }
+        return settled_count;
+    }
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    Heuristic heuristic_;
+};
+
+template <typename Weight>
+DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph, Heuristic heuristic)
+    : graph_(graph)
+    , heuristic_(std::move(heuristic))
+{
+    if (!graph.IsFrozen()) {
+        throw std::invalid_argument("Graph should be frozen");
+    }
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight>
+bool DijkstraRouter<Weight>::FillRoute(VertexId from, VertexId to, RouteInfo& route_info) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    SearchSpace& space = detail::GetSearchSpace<Weight>(vertex_count);
+    this->AddSettledVertices(Search(space, from, to));
+
+    if (!space.settled[to]) {
+        return false;
+    }
+
+    route_info.weight = space.weights[to];
+    std::vector<EdgeId>& edges = route_info.edges;
+    edges.clear();
+    for (EdgeId edge_id = space.prev_edges[to]; edge_id != SearchSpace::NO_EDGE;
+         edge_id = space.prev_edges[graph_.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return true;
+}
+
+template <typename Weight>
+std::vector<std::optional<typename DijkstraRouter<Weight>::RouteInfo>>
+DijkstraRouter<Weight>::BuildRoutes(VertexId from, const std::vector<VertexId>& targets) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    SearchSpace& space = detail::GetSearchSpace<Weight>(vertex_count);
+    this->AddSettledVertices(detail::SearchTree(graph_, space, from, targets));
+    return detail::ExtractRoutes(graph_, space, targets);
+}
+
+// Дейкстра с зависящими от времени весами рёбер: get_arrival(edge_id, time) возвращает время прибытия
+// в конец ребра при отправлении из его начала в момент time. Функции рёбер должны сохранять порядок
+// (FIFO: выехавший раньше не приезжает позже), тогда ранняя остановка по цели остаётся точной.
+// Вес результата - время прибытия в to; веса рёбер графа не используются.
+template <typename Weight, typename ArrivalFunction>
+std::optional<typename RouterBase<Weight>::RouteInfo> BuildTimeDependentRoute(const DirectedWeightedGraph<Weight>& graph,
+                                                                              VertexId from, VertexId to,
+                                                                              Weight departure_time,
+                                                                              ArrivalFunction get_arrival) {
+    using SearchSpace = detail::SearchSpace<Weight>;
+
+    if (!graph.IsFrozen()) {
+        throw std::invalid_argument("Graph should be frozen");
+    }
+    const size_t vertex_count = graph.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    SearchSpace& space = detail::GetSearchSpace<Weight>(vertex_count);
+    space.Relax(from, departure_time, SearchSpace::NO_EDGE);
+    while (!space.heap.empty()) {
+        const VertexId vertex = space.PopHeap().second;
+        if (space.settled[vertex]) {
+            continue;
+        }
+        space.settled[vertex] = 1;
+        if (vertex == to) {
+            break;
+        }
+        const Weight time = space.weights[vertex];
+        for (const auto& edge : graph.GetOutgoingEdges(vertex)) {
+            const EdgeId edge_id = graph.GetEdgeId(edge);
+            if (!space.settled[edge.to] && graph.IsEdgeEnabled(edge_id)) {
+                space.Relax(edge.to, get_arrival(edge_id, time), edge_id);
+            }
+        }
+    }
+
+    if (!space.settled[to]) {
+        return std::nullopt;
+    }
+    std::vector<EdgeId> edges;
+    for (EdgeId edge_id = space.prev_edges[to]; edge_id != SearchSpace::NO_EDGE;
+         edge_id = space.prev_edges[graph.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+    return typename RouterBase<Weight>::RouteInfo{space.weights[to], std::move(edges)};
+}
+
+// Дейкстра из from, ограниченный весом пути max_weight: вершины с весом пути не больше max_weight
+// вместе с весами, по возрастанию веса. Вершины за границей не попадают в кучу, а рабочие массивы
+// сбрасываются только по затронутым вершинам, поэтому время поиска зависит от размера
+// достижимой области, а не всего графа.
+template <typename Weight>
+std::vector<std::pair<VertexId, Weight>> BuildReachableVertices(const DirectedWeightedGraph<Weight>& graph,
+                                                                VertexId from, Weight max_weight) {
+    using SearchSpace = detail::SearchSpace<Weight>;
+
+    if (!graph.IsFrozen()) {
+        throw std::invalid_argument("Graph should be frozen");
+    }
+    const size_t vertex_count = graph.GetVertexCount();
+    if (from >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    std::vector<std::pair<VertexId, Weight>> vertices;
+    if (max_weight < Weight{}) {
+        return vertices;
+    }
+    SearchSpace& space = detail::GetSearchSpace<Weight>(vertex_count);
+    space.Relax(from, Weight{}, SearchSpace::NO_EDGE);
+    while (!space.heap.empty()) {
+        const VertexId vertex = space.PopHeap().second;
+        if (space.settled[vertex]) {
+            continue;
+        }
+        space.settled[vertex] = 1;
+        const Weight weight = space.weights[vertex];
+        vertices.emplace_back(vertex, weight);
+        for (const auto& edge : graph.GetOutgoingEdges(vertex)) {
+            const EdgeId edge_id = graph.GetEdgeId(edge);
+            const Weight candidate_weight = weight + edge.weight;
+            if (!(max_weight < candidate_weight) && candidate_weight < space.weights[edge.to] && graph.IsEdgeEnabled(edge_id)) {
+                space.Relax(edge.to, candidate_weight, edge_id);
+            }
+        }
+    }
+    return vertices;
+}
+
+// Двунаправленный Дейкстра: прямой поиск от начала и обратный от конца по входящим рёбрам
+// встречаются посередине. Графу нужен обратный индекс (DirectedWeightedGraph::BuildReverseIndex).
+template <typename Weight>
+class BidirectionalDijkstraRouter : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using typename RouterBase<Weight>::RouteInfo;
+
+    explicit BidirectionalDijkstraRouter(const Graph& graph);
+
+    bool FillRoute(VertexId from, VertexId to, RouteInfo& route_info) const override;
+
+    // Обратный индекс графа и рабочие массивы двух поисков одного потока, в байтах
+    static size_t EstimateMemory(size_t vertex_count, size_t edge_count) {
+        return edge_count * sizeof(EdgeId) + vertex_count * sizeof(std::vector<EdgeId>)
+               + 2 * DijkstraRouter<Weight>::EstimateMemory(vertex_count);
+    }
+    // Встречный поиск на каждую цель не окупается: одно прямое дерево на все цели
+    std::vector<std::optional<RouteInfo>> BuildRoutes(VertexId from, const std::vector<VertexId>& targets) const override;
+
+private:
+    using SearchSpace = detail::SearchSpace<Weight>;
+
+    // Извлекает вершину из кучи одного направления и релаксирует её рёбра.
+    // Лучший вес пути обновляется, как только вершина достигнута обоими поисками.
+    // Возвращает true, если вершина извлечена впервые.
+    bool SearchStep(SearchSpace& space, const SearchSpace& other_space, bool is_forward,
+                    Weight& best_weight, VertexId& meeting_vertex) const {
+        const VertexId vertex = space.PopHeap().second;
+        if (space.settled[vertex]) {
+            return false;
+        }
+        space.settled[vertex] = 1;
+
+        const Weight weight = space.weights[vertex];
+        const auto relax = [&](const Edge<Weight>& edge, VertexId next_vertex) {
+            const EdgeId edge_id = graph_.GetEdgeId(edge);
+            if (graph_.IsEdgeEnabled(edge_id) && space.Relax(next_vertex, weight + edge.weight, edge_id)) {
+                const Weight other_weight = other_space.weights[next_vertex];
+                if (other_weight != SearchSpace::INFINITE_WEIGHT && space.weights[next_vertex] + other_weight < best_weight) {
+                    best_weight = space.weights[next_vertex] + other_weight;
+                    meeting_vertex = next_vertex;
+                }
+            }
+        };
+        if (is_forward) {
+            for (const auto& edge : graph_.GetOutgoingEdges(vertex)) {
+                relax(edge, edge.to);
+            }
+        }
+        else {
+            for (const EdgeId edge_id : graph_.GetIncomingEdges(vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                relax(edge, edge.from);
+            }
+        }
+        return true;
+    }
+
+    const Graph& graph_;
+};
+
+template <typename Weight>
+BidirectionalDijkstraRouter<Weight>::BidirectionalDijkstraRouter(const Graph& graph)
+    : graph_(graph)
+{
+    if (graph.GetVertexCount() > 0 && !graph.HasReverseIndex()) {
+        throw std::invalid_argument("Graph should have reverse index for bidirectional search");
+    }
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < Weight{}) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight>
+bool BidirectionalDijkstraRouter<Weight>::FillRoute(VertexId from, VertexId to, RouteInfo& route_info) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    SearchSpace& forward = detail::GetSearchSpace<Weight>(vertex_count, 0);
+    SearchSpace& backward = detail::GetSearchSpace<Weight>(vertex_count, 1);
+    forward.Relax(from, Weight{}, SearchSpace::NO_EDGE);
+    backward.Relax(to, Weight{}, SearchSpace::NO_EDGE);
+
+    Weight best_weight = from == to ? Weight{} : SearchSpace::INFINITE_WEIGHT;
+    VertexId meeting_vertex = from == to ? from : vertex_count;
+    size_t settled_count = 0;
+    // Останов, когда сумма минимумов куч не меньше лучшего найденного веса
+    while (!forward.heap.empty() && !backward.heap.empty()
+           && forward.heap.front().first + backward.heap.front().first < best_weight)
+    {
+        if (forward.heap.front().first <= backward.heap.front().first) {
+            settled_count += SearchStep(forward, backward, true, best_weight, meeting_vertex);
+        }
+        else {
+            settled_count += SearchStep(backward, forward, false, best_weight, meeting_vertex);
+        }
+    }
+    this->AddSettledVertices(settled_count);
+
+    if (meeting_vertex == vertex_count) {
+        return false;
+    }
+
+    route_info.weight = best_weight;
+    std::vector<EdgeId>& edges = route_info.edges;
+    edges.clear();
+    for (EdgeId edge_id = forward.prev_edges[meeting_vertex]; edge_id != SearchSpace::NO_EDGE;
+         edge_id = forward.prev_edges[graph_.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+    for (EdgeId edge_id = backward.prev_edges[meeting_vertex]; edge_id != SearchSpace::NO_EDGE;
+         edge_id = backward.prev_edges[graph_.GetEdge(edge_id).to])
+    {
+        edges.push_back(edge_id);
+    }
+
+    return true;
+}
+
+template <typename Weight>
+std::vector<std::optional<typename BidirectionalDijkstraRouter<Weight>::RouteInfo>>
+BidirectionalDijkstraRouter<Weight>::BuildRoutes(VertexId from, const std::vector<VertexId>& targets) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    SearchSpace& space = detail::GetSearchSpace<Weight>(vertex_count);
+    this->AddSettledVertices(detail::SearchTree(graph_, space, from, targets));
+    return detail::ExtractRoutes(graph_, space, targets);
+}
+
+}  // namespace graph
@@ -1,5 +1,8 @@
 #include "domain.h"
 
+#include <algorithm>
+#include <cmath>
+
 /*
  * В этом файле вы можете разместить классы/структуры, которые являются частью предметной области
  * (domain) вашего приложения и не зависят от транспортного справочника. Например Автобусные
@@ -11,4 +14,25 @@
  *
  * Если структура вашего приложения не позволяет так сделать, просто оставьте этот файл пустым.
  *
- */
\ No newline at end of file
+ */
+namespace tc {
+
+	bool BusSchedule::IsEmpty() const {
+		return departures.empty() && headway <= 0.0;
+	}
+
+	double BusSchedule::GetNextDeparture(double time) const {
+		const double day_start = std::floor(time / DAY_MINUTES) * DAY_MINUTES;
+		const double time_of_day = time - day_start;
+		if (!departures.empty()) {
+			const auto it = std::lower_bound(departures.begin(), departures.end(), time_of_day);
+			return it != departures.end() ? day_start + *it : day_start + DAY_MINUTES + departures.front();
+		}
+		if (time_of_day <= first_departure) {
+			return day_start + first_departure;
+		}
+		const double departure = first_departure + std::ceil((time_of_day - first_departure) / headway) * headway;
+		return departure <= last_departure ? day_start + departure : day_start + DAY_MINUTES + first_departure;
+	}
+
+} // namespace tc
@@ -21,20 +21,38 @@ namespace tc {
 
 	struct Stop {
 		Stop() = delete;
-		Stop(std::string name, geo::Coordinates coordinates);
+		Stop(std::string name, geo::Coordinates coordinates, size_t id);
 		std::string name;
 		geo::Coordinates coordinates;
+		size_t id;	// номер в порядке добавления в справочник: индекс в GetAllStops и во внутренних массивах
 	};
 
 	using StopPtr = const Stop*;
 
+	// Расписание отправлений автобуса от первой остановки маршрута, в минутах от начала суток;
+	// повторяется каждые сутки. Задаётся списком отправлений или интервалом движения.
+	struct BusSchedule {
+		static constexpr double DAY_MINUTES = 24.0 * 60.0;
+
+		std::vector<double> departures;	// по возрастанию, в пределах [0, DAY_MINUTES)
+		double headway = 0.0;	// интервал движения, если departures пусто
+		double first_departure = 0.0;
+		double last_departure = DAY_MINUTES;
+
+		bool IsEmpty() const;
+		// Ближайшее отправление не раньше time; time и результат могут выходить за пределы суток
+		double GetNextDeparture(double time) const;
+	};
+
 	struct Bus {
 		Bus() = delete;
-		Bus(std::string name, std::vector<StopPtr> stops, StopPtr end_stop_ptr, bool is_roundtrip);
+		Bus(std::string name, std::vector<StopPtr> stops, StopPtr end_stop_ptr, bool is_roundtrip, size_t id);
 		std::string name;
 		std::vector<StopPtr> stops;
 		StopPtr end_stop_ptr;
 		bool is_roundtrip;
+		size_t id;	// номер в порядке добавления в справочник: индекс в GetAllBuses
+		BusSchedule schedule;	// пустое - время ожидания берётся из настроек маршрутизации
 	};
 
 	using BusPtr = const Bus*;
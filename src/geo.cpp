@@ -1,16 +1,147 @@
 #define _USE_MATH_DEFINES
 #include "geo.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <utility>
 
 namespace geo {
 
 double ComputeDistance(Coordinates from, Coordinates to) {
     using namespace std;
-    const double dr = M_PI / 180.0;
+    const double dr = DEGREE_TO_RADIAN;
     return acos(sin(from.lat * dr) * sin(to.lat * dr)
                 + cos(from.lat * dr) * cos(to.lat * dr) * cos(abs(from.lng - to.lng) * dr))
-        * 6371000;
+        * EARTH_RADIUS;
+}
+
+std::vector<NearbyPair> FindNearbyPairs(const std::vector<Coordinates>& points, double radius) {
+    using namespace std;
+    vector<NearbyPair> pairs;
+    if (points.size() < 2 || !(radius > 0.0)) {
+        return pairs;
+    }
+
+    // Равнопромежуточная проекция с масштабом долготы самой удалённой от экватора широты строки
+    // и её соседних строк не удлиняет расстояния больше чем на доли процента от radius, поэтому
+    // близкие точки оказываются в соседних ячейках сетки с небольшим запасом в размере ячейки.
+    // Масштаб свой у каждой строки: одна точка у полюса не сжимает остальные строки в один столбец.
+    const double lat_scale = EARTH_RADIUS * DEGREE_TO_RADIAN;
+    const double cell_size = radius * 1.001;
+    const double row_height = cell_size / lat_scale;  // градусов широты
+
+    const auto get_row = [&](double lat) {
+        return static_cast<int64_t>(floor(lat / row_height));
+    };
+    // столбец долготы lng в масштабе строки row
+    const auto get_column = [&](double lng, int64_t row) {
+        const double max_abs_lat = min(max(abs((row - 1) * row_height), abs((row + 2) * row_height)), 90.0);
+        const double lng_scale = lat_scale * cos(max_abs_lat * DEGREE_TO_RADIAN);
+        return static_cast<int64_t>(floor(lng * lng_scale / cell_size));
+    };
+
+    using Cell = pair<int64_t, int64_t>;  // строка, столбец в её масштабе
+    const auto get_cell = [&](const Coordinates& point) {
+        const int64_t row = get_row(point.lat);
+        return Cell{row, get_column(point.lng, row)};
+    };
+
+    // точки, отсортированные по ячейкам: точки ячейки и соседних по строке ячеек идут подряд
+    vector<pair<Cell, size_t>> cells;
+    cells.reserve(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        cells.emplace_back(get_cell(points[i]), i);
+    }
+    sort(cells.begin(), cells.end());
+
+    for (const auto& [cell, i] : cells) {
+        for (int64_t row = cell.first - 1; row <= cell.first + 1; ++row) {
+            const int64_t column = get_column(points[i].lng, row);
+            auto it = lower_bound(cells.begin(), cells.end(), pair{Cell{row, column - 1}, size_t{0}});
+            for (; it != cells.end() && it->first.first == row && it->first.second <= column + 1; ++it) {
+                const size_t j = it->second;
+                if (j <= i) {
+                    continue;
+                }
+                double distance = ComputeDistance(points[i], points[j]);
+                if (isnan(distance)) {
+                    // у совпадающих точек аргумент acos из-за округления может чуть превысить 1
+                    distance = 0.0;
+                }
+                if (distance <= radius) {
+                    pairs.push_back(NearbyPair{i, j, distance});
+                }
+            }
+        }
+    }
+    sort(pairs.begin(), pairs.end(), [](const NearbyPair& lhs, const NearbyPair& rhs) {
+        return pair{lhs.first, lhs.second} < pair{rhs.first, rhs.second};
+    });
+    return pairs;
+}
+
+namespace {
+
+// Номер ячейки (x, y) сетки side x side вдоль кривой Гильберта; side - степень двойки
+uint64_t GetHilbertIndex(uint32_t side, uint32_t x, uint32_t y) {
+    uint64_t index = 0;
+    for (uint32_t half = side / 2; half > 0; half /= 2) {
+        const uint32_t rx = (x & half) ? 1 : 0;
+        const uint32_t ry = (y & half) ? 1 : 0;
+        index += static_cast<uint64_t>(half) * half * ((3 * rx) ^ ry);
+        // поворот четверти, чтобы кривая внутри неё шла в том же направлении, что и целиком
+        if (ry == 0) {
+            if (rx == 1) {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
+
+}  // namespace
+
+std::vector<size_t> ComputeHilbertOrder(const std::vector<Coordinates>& points) {
+    using namespace std;
+    vector<size_t> order(points.size());
+    if (points.empty()) {
+        return order;
+    }
+
+    double min_lat = points.front().lat;
+    double max_lat = min_lat;
+    double min_lng = points.front().lng;
+    double max_lng = min_lng;
+    for (const Coordinates& point : points) {
+        min_lat = min(min_lat, point.lat);
+        max_lat = max(max_lat, point.lat);
+        min_lng = min(min_lng, point.lng);
+        max_lng = max(max_lng, point.lng);
+    }
+    constexpr uint32_t side = 1u << 16;
+    const auto to_cell = [side](double value, double min_value, double max_value) {
+        if (!(max_value > min_value)) {
+            return uint32_t{0};
+        }
+        const double cell = (value - min_value) / (max_value - min_value) * (side - 1);
+        return static_cast<uint32_t>(clamp(cell, 0.0, static_cast<double>(side - 1)));
+    };
+
+    vector<pair<uint64_t, size_t>> indices;
+    indices.reserve(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        const uint32_t x = to_cell(points[i].lng, min_lng, max_lng);
+        const uint32_t y = to_cell(points[i].lat, min_lat, max_lat);
+        indices.emplace_back(GetHilbertIndex(side, x, y), i);
+    }
+    sort(indices.begin(), indices.end());
+    for (size_t i = 0; i < indices.size(); ++i) {
+        order[i] = indices[i].second;
+    }
+    return order;
 }
 
 }  // namespace geo
\ No newline at end of file
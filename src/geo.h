@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstddef>
+#include <vector>
+
 namespace geo {
 
     struct Coordinates {
@@ -7,6 +10,28 @@ namespace geo {
         double lng; // Долгота
     };
 
+    inline constexpr double EARTH_RADIUS = 6371000.0; // Метры
+    inline constexpr double DEGREE_TO_RADIAN = 3.1415926535897932384626433832795 / 180.0;
+
     double ComputeDistance(Coordinates from, Coordinates to);
 
+    // Пара точек из набора: индексы first < second и расстояние между ними в метрах
+    struct NearbyPair {
+        size_t first;
+        size_t second;
+        double distance;
+    };
+
+    // Все пары точек не дальше radius метров друг от друга, упорядоченные по (first, second).
+    // Точки раскладываются по сетке с ячейкой чуть больше radius (ширина столбцов в градусах долготы -
+    // по широте строки), и расстояние считается только до точек соседних ячеек:
+    // O(n log n + число близких пар) вместо O(n^2).
+    // Переход через 180-й меридиан не учитывается.
+    std::vector<NearbyPair> FindNearbyPairs(const std::vector<Coordinates>& points, double radius);
+
+    // Индексы точек в порядке обхода кривой Гильберта по сетке 2^16 x 2^16 на их ограничивающем
+    // прямоугольнике (широта и долгота как плоские координаты): близкие точки почти всегда оказываются
+    // рядом в порядке. Точки одной ячейки сохраняют исходный порядок.
+    std::vector<size_t> ComputeHilbertOrder(const std::vector<Coordinates>& points);
+
 }  // namespace geo
\ No newline at end of file
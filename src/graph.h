@@ -2,7 +2,9 @@
 
 #include "ranges.h"
 
+#include <cassert>
 #include <cstdlib>
+#include <stdexcept>
 #include <vector>
 
 namespace graph {
@@ -17,43 +19,151 @@ struct Edge {
     Weight weight;
 };
 
+// Граф строится добавлением рёбер, затем замораживается (Freeze) в сжатое строчное представление (CSR):
+// рёбра лежат в одном массиве подряд по вершине начала, вершине соответствует диапазон
+// [offsets[v], offsets[v + 1]) этого массива. Номер ребра - его позиция в массиве, поэтому при обходе
+// исходящих рёбер конец и вес читаются из той же строки кэша, без второго обращения по номеру.
+// Поиск по графу (GetOutgoingEdges, обратный индекс) доступен только после заморозки.
 template <typename Weight>
 class DirectedWeightedGraph {
 private:
-    using IncidenceList = std::vector<EdgeId>;
-    using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
+    using OutgoingEdgesRange = ranges::Range<const Edge<Weight>*>;
+    using IncomingEdgesRange = ranges::Range<const EdgeId*>;
 
 public:
     DirectedWeightedGraph() = default;
     explicit DirectedWeightedGraph(size_t vertex_count);
     EdgeId AddEdge(const Edge<Weight>& edge);
+    // Резервирует память под рёбра, когда их число известно заранее
+    void ReserveEdges(size_t edge_count);
+
+    // Упорядочивает рёбра по вершине начала (порядок рёбер одной вершины сохраняется) и строит смещения.
+    // Возвращает новые номера рёбер: new_edge_ids[старый номер]. После заморозки рёбра не добавляются.
+    std::vector<EdgeId> Freeze();
+    bool IsFrozen() const;
+    // Перенумеровывает вершины замороженного графа: вершина v получает номер new_vertex_ids[v].
+    // Граф замораживается заново, рёбра одной вершины сохраняют порядок, обратный индекс сбрасывается.
+    // Возвращает новые номера рёбер, как Freeze.
+    std::vector<EdgeId> RenumberVertices(const std::vector<VertexId>& new_vertex_ids);
 
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
-    IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
+    // Исходящие рёбра вершины подряд в массиве рёбер, без проверок границ; номер ребра - GetEdgeId
+    OutgoingEdgesRange GetOutgoingEdges(VertexId vertex) const;
+    EdgeId GetEdgeId(const Edge<Weight>& edge) const;
+
+    // Меняет вес ребра без изменения структуры графа
+    void SetEdgeWeight(EdgeId edge_id, Weight weight);
+
+    // Маска рёбер замороженного графа: отключённое ребро сохраняет номер, но поиск его пропускает.
+    // Так перерывы в движении применяются без перестроения графа; предрасчёт движков
+    // после изменения маски обновляется через RouterBase::UpdateEdges.
+    void SetEdgeEnabled(EdgeId edge_id, bool is_enabled);
+    bool IsEdgeEnabled(EdgeId edge_id) const;
+    size_t GetDisabledEdgeCount() const;
+
+    // Обратный индекс входящих рёбер (нужен для поиска от конца пути) строится по требованию
+    // для замороженного графа, тоже в виде смещений и одного массива номеров рёбер
+    void BuildReverseIndex();
+    bool HasReverseIndex() const;
+    IncomingEdgesRange GetIncomingEdges(VertexId vertex) const;
 
 private:
+    size_t vertex_count_ = 0;
     std::vector<Edge<Weight>> edges_;
-    std::vector<IncidenceList> incidence_lists_;
+    std::vector<EdgeId> offsets_;  // vertex_count_ + 1 после заморозки
+    std::vector<EdgeId> reverse_offsets_;
+    std::vector<EdgeId> reverse_edge_ids_;
+    std::vector<char> disabled_edges_;  // по номерам рёбер; пусто, пока ни одно ребро не отключалось
+    size_t disabled_edge_count_ = 0;
 };
 
 template <typename Weight>
 DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-    : incidence_lists_(vertex_count) {
+    : vertex_count_(vertex_count) {
 }
 
 template <typename Weight>
 EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+    if (IsFrozen()) {
+        throw std::logic_error("Unable to add an edge to a frozen graph");
+    }
+    if (edge.from >= vertex_count_ || edge.to >= vertex_count_) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
     edges_.push_back(edge);
-    const EdgeId id = edges_.size() - 1;
-    incidence_lists_.at(edge.from).push_back(id);
-    return id;
+    return edges_.size() - 1;
+}
+
+template <typename Weight>
+std::vector<EdgeId> DirectedWeightedGraph<Weight>::Freeze() {
+    std::vector<EdgeId> new_edge_ids(edges_.size());
+    if (IsFrozen()) {
+        for (EdgeId edge_id = 0; edge_id < edges_.size(); ++edge_id) {
+            new_edge_ids[edge_id] = edge_id;
+        }
+        return new_edge_ids;
+    }
+
+    // устойчивая сортировка подсчётом по вершине начала
+    offsets_.assign(vertex_count_ + 1, 0);
+    for (const Edge<Weight>& edge : edges_) {
+        ++offsets_[edge.from + 1];
+    }
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        offsets_[vertex + 1] += offsets_[vertex];
+    }
+    std::vector<EdgeId> fill_positions(offsets_.begin(), offsets_.end() - 1);
+    std::vector<Edge<Weight>> edges(edges_.size());
+    for (EdgeId edge_id = 0; edge_id < edges_.size(); ++edge_id) {
+        const EdgeId new_edge_id = fill_positions[edges_[edge_id].from]++;
+        edges[new_edge_id] = edges_[edge_id];
+        new_edge_ids[edge_id] = new_edge_id;
+    }
+    edges_ = std::move(edges);
+    return new_edge_ids;
+}
+
+template <typename Weight>
+std::vector<EdgeId> DirectedWeightedGraph<Weight>::RenumberVertices(const std::vector<VertexId>& new_vertex_ids) {
+    if (!IsFrozen()) {
+        throw std::logic_error("Unable to renumber vertices of a graph that is not frozen");
+    }
+    if (new_vertex_ids.size() != vertex_count_) {
+        throw std::invalid_argument("Vertex permutation size should match vertex count");
+    }
+    for (Edge<Weight>& edge : edges_) {
+        edge.from = new_vertex_ids[edge.from];
+        edge.to = new_vertex_ids[edge.to];
+    }
+    offsets_.clear();
+    reverse_offsets_.clear();
+    reverse_edge_ids_.clear();
+    std::vector<EdgeId> new_edge_ids = Freeze();
+    if (!disabled_edges_.empty()) {
+        std::vector<char> disabled_edges(disabled_edges_.size());
+        for (EdgeId edge_id = 0; edge_id < new_edge_ids.size(); ++edge_id) {
+            disabled_edges[new_edge_ids[edge_id]] = disabled_edges_[edge_id];
+        }
+        disabled_edges_ = std::move(disabled_edges);
+    }
+    return new_edge_ids;
+}
+
+template <typename Weight>
+bool DirectedWeightedGraph<Weight>::IsFrozen() const {
+    return !offsets_.empty();
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::ReserveEdges(size_t edge_count) {
+    edges_.reserve(edge_count);
 }
 
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-    return incidence_lists_.size();
+    return vertex_count_;
 }
 
 template <typename Weight>
@@ -67,8 +177,84 @@ const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const
 }
 
 template <typename Weight>
-typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
-DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-    return ranges::AsRange(incidence_lists_.at(vertex));
+typename DirectedWeightedGraph<Weight>::OutgoingEdgesRange
+DirectedWeightedGraph<Weight>::GetOutgoingEdges(VertexId vertex) const {
+    assert(IsFrozen() && vertex < vertex_count_);
+    const Edge<Weight>* edges = edges_.data();
+    return {edges + offsets_[vertex], edges + offsets_[vertex + 1]};
+}
+
+template <typename Weight>
+EdgeId DirectedWeightedGraph<Weight>::GetEdgeId(const Edge<Weight>& edge) const {
+    return static_cast<EdgeId>(&edge - edges_.data());
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::SetEdgeWeight(EdgeId edge_id, Weight weight) {
+    edges_.at(edge_id).weight = weight;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::SetEdgeEnabled(EdgeId edge_id, bool is_enabled) {
+    if (!IsFrozen()) {
+        throw std::logic_error("Edge mask needs a frozen graph");
+    }
+    if (edge_id >= edges_.size()) {
+        throw std::out_of_range("Edge id is out of range");
+    }
+    if (disabled_edges_.empty()) {
+        if (is_enabled) {
+            return;
+        }
+        disabled_edges_.assign(edges_.size(), 0);
+    }
+    const char is_disabled = is_enabled ? 0 : 1;
+    if (disabled_edges_[edge_id] != is_disabled) {
+        disabled_edges_[edge_id] = is_disabled;
+        disabled_edge_count_ = is_disabled ? disabled_edge_count_ + 1 : disabled_edge_count_ - 1;
+    }
+}
+
+template <typename Weight>
+bool DirectedWeightedGraph<Weight>::IsEdgeEnabled(EdgeId edge_id) const {
+    // без отключённых рёбер маска не читается вовсе
+    return disabled_edge_count_ == 0 || !disabled_edges_[edge_id];
+}
+
+template <typename Weight>
+size_t DirectedWeightedGraph<Weight>::GetDisabledEdgeCount() const {
+    return disabled_edge_count_;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::BuildReverseIndex() {
+    if (!IsFrozen()) {
+        throw std::logic_error("Reverse index needs a frozen graph");
+    }
+    reverse_offsets_.assign(vertex_count_ + 1, 0);
+    for (const Edge<Weight>& edge : edges_) {
+        ++reverse_offsets_[edge.to + 1];
+    }
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        reverse_offsets_[vertex + 1] += reverse_offsets_[vertex];
+    }
+    std::vector<EdgeId> fill_positions(reverse_offsets_.begin(), reverse_offsets_.end() - 1);
+    reverse_edge_ids_.resize(edges_.size());
+    for (EdgeId edge_id = 0; edge_id < edges_.size(); ++edge_id) {
+        reverse_edge_ids_[fill_positions[edges_[edge_id].to]++] = edge_id;
+    }
+}
+
+template <typename Weight>
+bool DirectedWeightedGraph<Weight>::HasReverseIndex() const {
+    return !reverse_offsets_.empty();
+}
+
+template <typename Weight>
+typename DirectedWeightedGraph<Weight>::IncomingEdgesRange
+DirectedWeightedGraph<Weight>::GetIncomingEdges(VertexId vertex) const {
+    assert(HasReverseIndex() && vertex < vertex_count_);
+    const EdgeId* edge_ids = reverse_edge_ids_.data();
+    return {edge_ids + reverse_offsets_[vertex], edge_ids + reverse_offsets_[vertex + 1]};
 }
 }  // namespace graph
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <sstream>
 
 /*
@@ -62,6 +63,46 @@ namespace tc::io {
         return result;
     }
 
+    /**
+     * Парсит необязательное расписание маршрута, в минутах от начала суток:
+     * "departures" - список отправлений от первой остановки
+     * или "headway" - интервал движения с необязательными "first_departure" и "last_departure".
+     */
+    BusSchedule ParseBusSchedule(const json::Node& request_node) {
+        const json::Dict& request_dict = request_node.AsMap();
+        BusSchedule schedule;
+        if (const auto it = request_dict.find("departures"s); it != request_dict.end()) {
+            for (const json::Node& departure_node : it->second.AsArray()) {
+                if (!std::isfinite(departure_node.AsDouble())) {
+                    throw std::invalid_argument("Bus departure should be a finite number"s);
+                }
+                const double departure = std::fmod(departure_node.AsDouble(), BusSchedule::DAY_MINUTES);
+                schedule.departures.push_back(departure < 0.0 ? departure + BusSchedule::DAY_MINUTES : departure);
+            }
+            std::sort(schedule.departures.begin(), schedule.departures.end());
+        }
+        else if (const auto headway_it = request_dict.find("headway"s); headway_it != request_dict.end()) {
+            schedule.headway = headway_it->second.AsDouble();
+            if (!(schedule.headway > 0.0 && schedule.headway <= BusSchedule::DAY_MINUTES)) {
+                throw std::invalid_argument("Bus headway should be positive and not longer than a day"s);
+            }
+            if (const auto first_it = request_dict.find("first_departure"s); first_it != request_dict.end()) {
+                schedule.first_departure = first_it->second.AsDouble();
+            }
+            if (const auto last_it = request_dict.find("last_departure"s); last_it != request_dict.end()) {
+                schedule.last_departure = last_it->second.AsDouble();
+            }
+            // GetNextDeparture переносит отправления на следующие сутки, поэтому интервал работы - в пределах суток
+            if (!(schedule.first_departure >= 0.0 && schedule.first_departure < BusSchedule::DAY_MINUTES)) {
+                throw std::invalid_argument("Bus first departure should be within a day"s);
+            }
+            if (!(schedule.last_departure >= schedule.first_departure && schedule.last_departure <= BusSchedule::DAY_MINUTES)) {
+                throw std::invalid_argument("Bus last departure should be within a day and not before the first one"s);
+            }
+        }
+        return schedule;
+    }
+
     json::Node PrintBusStat(const TransportCatalogue& catalogue, const json::Node& request_node) {
         assert(request_node.IsDict() && request_node.AsMap().at("type"s).AsString() == "Bus"s);
         const json::Dict& request_dict = request_node.AsMap();
@@ -123,6 +164,37 @@ namespace tc::io {
         return builder.Build();
     }
 
+    json::Node PrintRouteItems(const router::Route& route) {
+        json::Builder builder{};
+        builder.StartArray();
+        for (const router::RouteItem& item : route.items) {
+            if (item.type == router::RouteType::WAIT) {
+                builder.StartDict()
+                    .Key("type"s).Value("Wait"s)
+                    .Key("stop_name"s).Value(std::string{ item.name })
+                    .Key("time"s).Value(item.time)
+                    .EndDict();
+            }
+            else if (item.type == router::RouteType::BUS) {
+                builder.StartDict()
+                    .Key("type"s).Value("Bus"s)
+                    .Key("bus"s).Value(std::string{ item.name })
+                    .Key("span_count"s).Value(item.span_count)
+                    .Key("time"s).Value(item.time)
+                    .EndDict();
+            }
+            else if (item.type == router::RouteType::WALK) {
+                builder.StartDict()
+                    .Key("type"s).Value("Walk"s)
+                    .Key("from"s).Value(std::string{ item.name })
+                    .Key("to"s).Value(std::string{ item.to_name })
+                    .Key("time"s).Value(item.time)
+                    .EndDict();
+            }
+        }
+        return builder.EndArray().Build();
+    }
+
     json::Node PrintRouteStat(const TransportCatalogue& catalogue, const json::Node& request_node, const router::TransportRouter& router) {
         assert(request_node.IsDict() && request_node.AsMap().at("type"s).AsString() == "Route"s);
         const json::Dict& request_dict = request_node.AsMap();
@@ -130,7 +202,48 @@ namespace tc::io {
         StopPtr stop_from = catalogue.GetStop(request_dict.at("from"s).AsString());
         StopPtr stop_to = catalogue.GetStop(request_dict.at("to"s).AsString());
 
-        std::optional<router::Route> route = router.FindRoute(stop_from, stop_to);
+        // с "k" - до k маршрутов без повторения остановок в массиве "routes", по возрастанию времени
+        if (const auto k_it = request_dict.find("k"s); k_it != request_dict.end()) {
+            const std::vector<router::Route> routes = router.FindAlternativeRoutes(stop_from, stop_to, static_cast<size_t>(std::max(k_it->second.AsInt(), 0)));
+            json::Builder builder{};
+            builder.StartDict().Key("request_id"s).Value(request_dict.at("id"s).AsInt());
+            if (routes.empty()) {
+                return builder.Key("error_message"s).Value("not found"s).EndDict().Build();
+            }
+            builder.Key("routes"s).StartArray();
+            for (const router::Route& route : routes) {
+                builder.StartDict()
+                    .Key("total_time"s).Value(route.total_time)
+                    .Key("items"s).Value(PrintRouteItems(route).AsArray())
+                    .EndDict();
+            }
+            return builder.EndArray().EndDict().Build();
+        }
+
+        // с "pareto": true - маршруты, не уступающие друг другу одновременно по времени и числу пересадок
+        if (const auto pareto_it = request_dict.find("pareto"s); pareto_it != request_dict.end() && pareto_it->second.AsBool()) {
+            const std::vector<router::ParetoRoute> routes = router.FindParetoRoutes(stop_from, stop_to);
+            json::Builder builder{};
+            builder.StartDict().Key("request_id"s).Value(request_dict.at("id"s).AsInt());
+            if (routes.empty()) {
+                return builder.Key("error_message"s).Value("not found"s).EndDict().Build();
+            }
+            builder.Key("routes"s).StartArray();
+            for (const router::ParetoRoute& pareto_route : routes) {
+                builder.StartDict()
+                    .Key("total_time"s).Value(pareto_route.route.total_time)
+                    .Key("transfers"s).Value(pareto_route.transfer_count)
+                    .Key("items"s).Value(PrintRouteItems(pareto_route.route).AsArray())
+                    .EndDict();
+            }
+            return builder.EndArray().EndDict().Build();
+        }
+
+        // с "departure_time" (минуты от начала суток) ожидание считается по расписаниям автобусов
+        const auto departure_time_it = request_dict.find("departure_time"s);
+        std::optional<router::Route> route = departure_time_it == request_dict.end()
+            ? router.FindRoute(stop_from, stop_to)
+            : router.FindRoute(stop_from, stop_to, departure_time_it->second.AsDouble());
 
         json::Builder builder{};
         builder.StartDict().Key("request_id"s).Value(request_dict.at("id"s).AsInt());
@@ -138,28 +251,99 @@ namespace tc::io {
             return builder.Key("error_message"s).Value("not found"s).EndDict().Build();
         }
         builder.Key("total_time"s).Value((*route).total_time);
-        builder.Key("items"s).StartArray();
-        for (std::shared_ptr<router::RouteStat> route_stat : (*route).items) {
-            router::RouteType type = route_stat->GetType();
-            if (type == router::RouteType::WAIT) {
-                const router::WaitRouteStat& stat = *(static_cast<router::WaitRouteStat*>(route_stat.get()));
-                builder.StartDict()
-                    .Key("type"s).Value("Wait"s)
-                    .Key("stop_name"s).Value(std::string{ stat.stop_name })
-                    .Key("time"s).Value(stat.time)
-                    .EndDict();
+        builder.Key("items"s).Value(PrintRouteItems(*route).AsArray());
+        builder.EndDict();
+
+        return builder.Build();
+    }
+
+    // Остановки, достижимые из "from" не дольше чем за "max_time" минут, по возрастанию времени
+    json::Node PrintIsochroneStat(const TransportCatalogue& catalogue, const json::Node& request_node, const router::TransportRouter& router) {
+        assert(request_node.IsDict() && request_node.AsMap().at("type"s).AsString() == "Isochrone"s);
+        const json::Dict& request_dict = request_node.AsMap();
+
+        StopPtr stop_from = catalogue.GetStop(request_dict.at("from"s).AsString());
+        const std::vector<router::ReachableStop> stops = router.FindReachableStops(stop_from, request_dict.at("max_time"s).AsDouble());
+
+        json::Builder builder{};
+        builder.StartDict().Key("request_id"s).Value(request_dict.at("id"s).AsInt());
+        builder.Key("stops"s).StartArray();
+        for (const router::ReachableStop& stop : stops) {
+            builder.StartDict()
+                .Key("stop_name"s).Value(stop.stop->name)
+                .Key("time"s).Value(stop.time)
+                .EndDict();
+        }
+        builder.EndArray().EndDict();
+
+        return builder.Build();
+    }
+
+    // Остановки запроса RouteMatrix: одно название или массив названий
+    std::vector<StopPtr> ParseStopList(const TransportCatalogue& catalogue, const json::Node& node) {
+        std::vector<StopPtr> stops;
+        if (node.IsString()) {
+            stops.push_back(catalogue.GetStop(node.AsString()));
+            return stops;
+        }
+        for (const json::Node& stop_name_node : node.AsArray()) {
+            stops.push_back(catalogue.GetStop(stop_name_node.AsString()));
+        }
+        return stops;
+    }
+
+    /**
+     * Матрица маршрутов между остановками "from" и "to" (название или массив названий).
+     * total_times[i][j] - время от i-й остановки from до j-й остановки to, null - маршрута нет.
+     * При "items": true добавляется routes[i][j] с элементами маршрутов, как в запросе Route.
+     */
+    json::Node PrintRouteMatrixStat(const TransportCatalogue& catalogue, const json::Node& request_node, const router::TransportRouter& router) {
+        assert(request_node.IsDict() && request_node.AsMap().at("type"s).AsString() == "RouteMatrix"s);
+        const json::Dict& request_dict = request_node.AsMap();
+
+        const std::vector<StopPtr> stops_from = ParseStopList(catalogue, request_dict.at("from"s));
+        const std::vector<StopPtr> stops_to = ParseStopList(catalogue, request_dict.at("to"s));
+        const auto items_it = request_dict.find("items"s);
+        const bool with_items = items_it != request_dict.end() && items_it->second.AsBool();
+
+        const std::vector<std::vector<std::optional<router::Route>>> matrix = router.FindRouteMatrix(stops_from, stops_to);
+
+        json::Builder builder{};
+        builder.StartDict().Key("request_id"s).Value(request_dict.at("id"s).AsInt());
+        builder.Key("total_times"s).StartArray();
+        for (const auto& row : matrix) {
+            builder.StartArray();
+            for (const std::optional<router::Route>& route : row) {
+                if (route.has_value()) {
+                    builder.Value(route->total_time);
+                }
+                else {
+                    builder.Value(nullptr);
+                }
             }
-            else if (type == router::RouteType::BUS) {
-                const router::BusRouteStat& stat = *(static_cast<router::BusRouteStat*>(route_stat.get()));
-                builder.StartDict()
-                    .Key("type"s).Value("Bus"s)
-                    .Key("bus"s).Value(std::string{ stat.bus_name })
-                    .Key("span_count"s).Value(stat.span_count)
-                    .Key("time"s).Value(stat.time)
-                    .EndDict();
+            builder.EndArray();
+        }
+        builder.EndArray();
+        if (with_items) {
+            builder.Key("routes"s).StartArray();
+            for (const auto& row : matrix) {
+                builder.StartArray();
+                for (const std::optional<router::Route>& route : row) {
+                    if (route.has_value()) {
+                        builder.StartDict()
+                            .Key("total_time"s).Value(route->total_time)
+                            .Key("items"s).Value(PrintRouteItems(*route).AsArray())
+                            .EndDict();
+                    }
+                    else {
+                        builder.Value(nullptr);
+                    }
+                }
+                builder.EndArray();
             }
+            builder.EndArray();
         }
-        builder.EndArray().EndDict();
+        builder.EndDict();
 
         return builder.Build();
     }
@@ -189,6 +373,110 @@ namespace tc::io {
         return { array[0].AsDouble(), array[1].AsDouble() };
     }
 
+    // Названия движков маршрутизации в routing_settings.router_engine
+    const std::pair<std::string_view, router::RouterEngineType> ROUTER_ENGINE_NAMES[] = {
+        { "all_pairs"sv, router::RouterEngineType::ALL_PAIRS },
+        { "all_pairs_compact"sv, router::RouterEngineType::ALL_PAIRS_COMPACT },
+        { "all_pairs_fixed"sv, router::RouterEngineType::ALL_PAIRS_FIXED },
+        { "dijkstra"sv, router::RouterEngineType::DIJKSTRA },
+        { "a_star"sv, router::RouterEngineType::A_STAR },
+        { "bidirectional_dijkstra"sv, router::RouterEngineType::BIDIRECTIONAL_DIJKSTRA },
+        { "contraction_hierarchy"sv, router::RouterEngineType::CONTRACTION_HIERARCHY },
+        { "raptor"sv, router::RouterEngineType::RAPTOR },
+        { "auto"sv, router::RouterEngineType::AUTO },
+    };
+
+    router::RouterEngineType ParseRouterEngine(const json::Node& node) {
+        const std::string& name = node.AsString();
+        for (const auto& [engine_name, engine] : ROUTER_ENGINE_NAMES) {
+            if (engine_name == name) {
+                return engine;
+            }
+        }
+        throw std::invalid_argument("Unknown router engine: "s + name);
+    }
+
+    std::string GetRouterEngineName(router::RouterEngineType engine) {
+        for (const auto& [engine_name, engine_type] : ROUTER_ENGINE_NAMES) {
+            if (engine_type == engine) {
+                return std::string{ engine_name };
+            }
+        }
+        return {};
+    }
+
+    // Названия моделей графа в routing_settings.graph_model
+    const std::pair<std::string_view, router::GraphModelType> GRAPH_MODEL_NAMES[] = {
+        { "stop_pairs"sv, router::GraphModelType::STOP_PAIRS },
+        { "ride_chains"sv, router::GraphModelType::RIDE_CHAINS },
+    };
+
+    router::GraphModelType ParseGraphModel(const json::Node& node) {
+        const std::string& name = node.AsString();
+        for (const auto& [model_name, model] : GRAPH_MODEL_NAMES) {
+            if (model_name == name) {
+                return model;
+            }
+        }
+        throw std::invalid_argument("Unknown graph model: "s + name);
+    }
+
+    std::string GetGraphModelName(router::GraphModelType model) {
+        for (const auto& [model_name, model_type] : GRAPH_MODEL_NAMES) {
+            if (model_type == model) {
+                return std::string{ model_name };
+            }
+        }
+        return {};
+    }
+
+    // Названия нумераций вершин в routing_settings.vertex_order
+    const std::pair<std::string_view, router::VertexOrderType> VERTEX_ORDER_NAMES[] = {
+        { "input"sv, router::VertexOrderType::INPUT_ORDER },
+        { "cuthill_mckee"sv, router::VertexOrderType::CUTHILL_MCKEE },
+        { "hilbert"sv, router::VertexOrderType::HILBERT },
+    };
+
+    router::VertexOrderType ParseVertexOrder(const json::Node& node) {
+        const std::string& name = node.AsString();
+        for (const auto& [order_name, order] : VERTEX_ORDER_NAMES) {
+            if (order_name == name) {
+                return order;
+            }
+        }
+        throw std::invalid_argument("Unknown vertex order: "s + name);
+    }
+
+    json::Node PrintRouterStats(const json::Node& request_node, const router::TransportRouter& router) {
+        assert(request_node.IsDict() && request_node.AsMap().at("type"s).AsString() == "RouterStats"s);
+        const json::Dict& request_dict = request_node.AsMap();
+
+        const router::RouterStats stats = router.GetStats();
+        const double average_query_time = stats.query_count ? stats.total_query_time / stats.query_count : 0.0;
+        const double average_settled_vertices = stats.query_count ? static_cast<double>(stats.settled_vertex_count) / stats.query_count : 0.0;
+
+        json::Builder builder{};
+        builder.StartDict().Key("request_id"s).Value(request_dict.at("id"s).AsInt())
+            .Key("engine"s).Value(GetRouterEngineName(stats.engine))
+            .Key("estimated_memory_mb"s).Value(static_cast<double>(stats.estimated_memory) / (1024 * 1024))
+            .Key("graph_model"s).Value(GetGraphModelName(stats.graph_model))
+            .Key("vertex_count"s).Value(static_cast<int>(stats.vertex_count))
+            .Key("edge_count"s).Value(static_cast<int>(stats.edge_count))
+            .Key("graph_build_time"s).Value(stats.graph_build_time)
+            .Key("router_build_time"s).Value(stats.router_build_time)
+            .Key("query_count"s).Value(static_cast<int>(stats.query_count))
+            .Key("average_query_time"s).Value(average_query_time)
+            .Key("average_settled_vertices"s).Value(average_settled_vertices)
+            .Key("cache_hits"s).Value(static_cast<int>(stats.cache_hit_count))
+            .Key("cache_misses"s).Value(static_cast<int>(stats.cache_miss_count))
+            .Key("snapshot_loaded"s).Value(stats.snapshot_loaded)
+            .Key("disabled_edge_count"s).Value(static_cast<int>(stats.disabled_edge_count))
+            .Key("disruption_update_time"s).Value(stats.disruption_update_time)
+            .EndDict();
+
+        return builder.Build();
+    }
+
     JsonReader::JsonReader() : json_(nullptr) {
     }
 
@@ -222,7 +510,7 @@ namespace tc::io {
             }
             std::string_view end_stop_name = (*(request_dict.at("stops"s).AsArray().rbegin())).AsString();
             StopPtr end_stop_ptr = catalogue.GetStop(end_stop_name);
-            catalogue.AddBus(request_dict.at("name"s).AsString(), stop_ptrs, end_stop_ptr, request_dict.at("is_roundtrip"s).AsBool());
+            catalogue.AddBus(request_dict.at("name"s).AsString(), stop_ptrs, end_stop_ptr, request_dict.at("is_roundtrip"s).AsBool(), ParseBusSchedule(node));
         }
 
         // Парсим и сохраняем расстояния между остановками
@@ -237,6 +525,8 @@ namespace tc::io {
                 catalogue.SetDistance(stop_from_ptr, stop_to_ptr, distance_pair.second);
             }
         }
+
+        catalogue.Finalize();
 	}
 
     void JsonReader::SaveStats(const tc::TransportCatalogue& catalogue, std::ostream& output, const renderer::MapRenderer& renderer, const router::TransportRouter& router) const {
@@ -265,6 +555,15 @@ namespace tc::io {
             else if (type == "Route"s) {
                 builder.Value(PrintRouteStat(catalogue, node, router).AsMap());
             }
+            else if (type == "RouteMatrix"s) {
+                builder.Value(PrintRouteMatrixStat(catalogue, node, router).AsMap());
+            }
+            else if (type == "Isochrone"s) {
+                builder.Value(PrintIsochroneStat(catalogue, node, router).AsMap());
+            }
+            else if (type == "RouterStats"s) {
+                builder.Value(PrintRouterStats(node, router).AsMap());
+            }
         }
 
         json::Document json_doc{ builder.EndArray().Build() };
@@ -312,6 +611,31 @@ namespace tc::io {
         settings.bus_velocity = routing_settings_dict.at("bus_velocity"s).AsDouble();
         settings.bus_wait_time = routing_settings_dict.at("bus_wait_time"s).AsInt();
 
+        if (const auto it = routing_settings_dict.find("router_engine"s); it != routing_settings_dict.end()) {
+            settings.engine = ParseRouterEngine(it->second);
+        }
+        if (const auto it = routing_settings_dict.find("memory_budget_mb"s); it != routing_settings_dict.end()) {
+            settings.memory_budget = static_cast<size_t>(it->second.AsDouble() * 1024 * 1024);
+        }
+        if (const auto it = routing_settings_dict.find("graph_model"s); it != routing_settings_dict.end()) {
+            settings.graph_model = ParseGraphModel(it->second);
+        }
+        if (const auto it = routing_settings_dict.find("vertex_order"s); it != routing_settings_dict.end()) {
+            settings.vertex_order = ParseVertexOrder(it->second);
+        }
+        if (const auto it = routing_settings_dict.find("walk_radius"s); it != routing_settings_dict.end()) {
+            settings.walk_radius = it->second.AsDouble();
+        }
+        if (const auto it = routing_settings_dict.find("walk_velocity"s); it != routing_settings_dict.end()) {
+            settings.walk_velocity = it->second.AsDouble();
+        }
+        if (const auto it = routing_settings_dict.find("route_cache_capacity"s); it != routing_settings_dict.end()) {
+            settings.route_cache_capacity = static_cast<size_t>(it->second.AsInt());
+        }
+        if (const auto it = routing_settings_dict.find("snapshot_path"s); it != routing_settings_dict.end()) {
+            settings.snapshot_path = it->second.AsString();
+        }
+
         return settings;
     }
 
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "dijkstra_router.h"
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+namespace detail {
+
+// Входящие рёбра вершин: обратный индекс графа или, если его нет, собственная копия
+template <typename Weight>
+class IncomingEdges {
+public:
+    explicit IncomingEdges(const DirectedWeightedGraph<Weight>& graph)
+        : graph_(graph)
+    {
+        if (graph.HasReverseIndex()) {
+            return;
+        }
+        incoming_edges_.resize(graph.GetVertexCount());
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            incoming_edges_[graph.GetEdge(edge_id).to].push_back(edge_id);
+        }
+    }
+
+    template <typename Func>
+    void ForEach(VertexId vertex, Func func) const {
+        if (incoming_edges_.empty()) {
+            for (const EdgeId edge_id : graph_.GetIncomingEdges(vertex)) {
+                func(edge_id);
+            }
+        }
+        else {
+            for (const EdgeId edge_id : incoming_edges_[vertex]) {
+                func(edge_id);
+            }
+        }
+    }
+
+private:
+    const DirectedWeightedGraph<Weight>& graph_;
+    std::vector<std::vector<EdgeId>> incoming_edges_;
+};
+
+}  // namespace detail
+
+// k кратчайших путей без повторения вершин (алгоритм Йена) из from в to по возрастанию веса.
+// Один обратный поиск от to даёт точные расстояния до цели во всём графе. Они служат эвристикой A*
+// для поиска ответвлений: удаление рёбер и вершин только увеличивает расстояния, поэтому оценка
+// остаётся допустимой и согласованной, а поиск просматривает лишь вершины около оптимума.
+// Если путь по дереву обратного поиска от вершины ответвления не задет удалениями,
+// он и есть ответвление, и поиск не нужен вовсе.
+template <typename Weight>
+std::vector<typename RouterBase<Weight>::RouteInfo> FindKShortestPaths(const DirectedWeightedGraph<Weight>& graph,
+                                                                       VertexId from, VertexId to, size_t k) {
+    using RouteInfo = typename RouterBase<Weight>::RouteInfo;
+    using SearchSpace = detail::SearchSpace<Weight>;
+
+    if (!graph.IsFrozen()) {
+        throw std::invalid_argument("Graph should be frozen");
+    }
+    const size_t vertex_count = graph.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    std::vector<RouteInfo> paths;
+    if (k == 0) {
+        return paths;
+    }
+
+    // Обратное дерево кратчайших путей: weights - расстояние до to, prev_edges - первое ребро пути к to
+    SearchSpace& tree = detail::GetSearchSpace<Weight>(vertex_count, 1);
+    const detail::IncomingEdges<Weight> incoming_edges{graph};
+    tree.Relax(to, Weight{}, SearchSpace::NO_EDGE);
+    while (!tree.heap.empty()) {
+        const VertexId vertex = tree.PopHeap().second;
+        if (tree.settled[vertex]) {
+            continue;
+        }
+        tree.settled[vertex] = 1;
+        const Weight weight = tree.weights[vertex];
+        incoming_edges.ForEach(vertex, [&](EdgeId edge_id) {
+            const auto& edge = graph.GetEdge(edge_id);
+            if (graph.IsEdgeEnabled(edge_id)) {
+                tree.Relax(edge.from, weight + edge.weight, edge_id);
+            }
+        });
+    }
+    if (!tree.settled[from]) {
+        return paths;
+    }
+
+    std::vector<char> blocked_vertices(vertex_count, 0);
+    std::vector<EdgeId> blocked_edges;
+    const auto is_blocked_edge = [&blocked_edges](EdgeId edge_id) {
+        return std::find(blocked_edges.begin(), blocked_edges.end(), edge_id) != blocked_edges.end();
+    };
+
+    // Путь по дереву от vertex до to, если он не задет удалениями
+    const auto follow_tree = [&](VertexId vertex, std::vector<EdgeId>& edges) {
+        for (; vertex != to; vertex = graph.GetEdge(tree.prev_edges[vertex]).to) {
+            const EdgeId edge_id = tree.prev_edges[vertex];
+            if (blocked_vertices[vertex] || is_blocked_edge(edge_id)) {
+                return false;
+            }
+            edges.push_back(edge_id);
+        }
+        return !blocked_vertices[to];
+    };
+
+    // A* от vertex до to в графе без заблокированных рёбер и вершин
+    const auto search_spur = [&](VertexId spur_vertex, std::vector<EdgeId>& edges) {
+        SearchSpace& space = detail::GetSearchSpace<Weight>(vertex_count, 0);
+        space.Relax(spur_vertex, Weight{}, SearchSpace::NO_EDGE, tree.weights[spur_vertex]);
+        while (!space.heap.empty()) {
+            const VertexId vertex = space.PopHeap().second;
+            if (space.settled[vertex]) {
+                continue;
+            }
+            space.settled[vertex] = 1;
+            if (vertex == to) {
+                break;
+            }
+            const Weight weight = space.weights[vertex];
+            for (const auto& edge : graph.GetOutgoingEdges(vertex)) {
+                const EdgeId edge_id = graph.GetEdgeId(edge);
+                if (blocked_vertices[edge.to] || !tree.settled[edge.to] || !graph.IsEdgeEnabled(edge_id) || is_blocked_edge(edge_id)) {
+                    continue;
+                }
+                space.Relax(edge.to, weight + edge.weight, edge_id, weight + edge.weight + tree.weights[edge.to]);
+            }
+        }
+        if (!space.settled[to]) {
+            return false;
+        }
+        const size_t begin = edges.size();
+        for (EdgeId edge_id = space.prev_edges[to]; edge_id != SearchSpace::NO_EDGE;
+             edge_id = space.prev_edges[graph.GetEdge(edge_id).from])
+        {
+            edges.push_back(edge_id);
+        }
+        std::reverse(edges.begin() + begin, edges.end());
+        return true;
+    };
+
+    const auto get_weight = [&graph](const std::vector<EdgeId>& edges) {
+        Weight weight{};
+        for (const EdgeId edge_id : edges) {
+            weight += graph.GetEdge(edge_id).weight;
+        }
+        return weight;
+    };
+
+    {
+        std::vector<EdgeId> edges;
+        follow_tree(from, edges);
+        const Weight weight = get_weight(edges);
+        paths.push_back(RouteInfo{weight, std::move(edges)});
+    }
+
+    std::multimap<Weight, std::vector<EdgeId>> candidates;
+    std::set<std::vector<EdgeId>> known_paths{paths.front().edges};
+    while (paths.size() < k) {
+        const std::vector<EdgeId> last_edges = paths.back().edges;
+        VertexId spur_vertex = from;
+        for (size_t spur_index = 0; spur_index < last_edges.size(); ++spur_index) {
+            // ответвление не может повторять следующее ребро уже найденных путей с тем же началом
+            blocked_edges.clear();
+            for (const RouteInfo& path : paths) {
+                if (path.edges.size() > spur_index
+                    && std::equal(last_edges.begin(), last_edges.begin() + spur_index, path.edges.begin())) {
+                    blocked_edges.push_back(path.edges[spur_index]);
+                }
+            }
+
+            std::vector<EdgeId> edges(last_edges.begin(), last_edges.begin() + spur_index);
+            bool is_found = follow_tree(spur_vertex, edges);
+            if (!is_found) {
+                edges.resize(spur_index);
+                is_found = search_spur(spur_vertex, edges);
+            }
+            if (is_found && known_paths.insert(edges).second) {
+                const Weight weight = get_weight(edges);
+                candidates.emplace(weight, std::move(edges));
+            }
+
+            // вершины начала пути не должны повторяться в ответвлениях
+            blocked_vertices[spur_vertex] = 1;
+            spur_vertex = graph.GetEdge(last_edges[spur_index]).to;
+        }
+        for (const EdgeId edge_id : last_edges) {
+            blocked_vertices[graph.GetEdge(edge_id).from] = 0;
+        }
+        blocked_vertices[from] = 0;
+
+        if (candidates.empty()) {
+            break;
+        }
+        auto best_it = candidates.begin();
+        paths.push_back(RouteInfo{best_it->first, std::move(best_it->second)});
+        candidates.erase(best_it);
+    }
+    return paths;
+}
+
+}  // namespace graph
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace util {
+
+    // Потокобезопасный кэш ограниченного размера с вытеснением давно не использованных записей (LRU).
+    // Записи хранятся в списке от самой свежей к самой старой, хеш-таблица указывает на узлы списка.
+    // Ёмкость 0 отключает кэш: Get всегда промахивается, Put ничего не делает.
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class LruCache {
+    public:
+        explicit LruCache(size_t capacity = 0) : capacity_(capacity) {
+        }
+
+        std::optional<Value> Get(const Key& key) const {
+            std::optional<Value> value;
+            Visit(key, [&value](const Value& cached_value) {
+                value = cached_value;
+            });
+            return value;
+        }
+
+        // Передаёт найденное значение в visitor под блокировкой, не копируя его;
+        // возвращает false при промахе
+        template <typename Visitor>
+        bool Visit(const Key& key, Visitor visitor) const {
+            if (capacity_ == 0) {
+                return false;
+            }
+            std::lock_guard lock(mutex_);
+            const auto it = index_.find(key);
+            if (it == index_.end()) {
+                ++miss_count_;
+                return false;
+            }
+            ++hit_count_;
+            entries_.splice(entries_.begin(), entries_, it->second);
+            visitor(it->second->second);
+            return true;
+        }
+
+        void Put(const Key& key, Value value) {
+            if (capacity_ == 0) {
+                return;
+            }
+            std::lock_guard lock(mutex_);
+            if (const auto it = index_.find(key); it != index_.end()) {
+                it->second->second = std::move(value);
+                entries_.splice(entries_.begin(), entries_, it->second);
+                return;
+            }
+            if (index_.size() == capacity_) {
+                index_.erase(entries_.back().first);
+                entries_.pop_back();
+            }
+            entries_.emplace_front(key, std::move(value));
+            index_.emplace(key, entries_.begin());
+        }
+
+        void Clear() {
+            std::lock_guard lock(mutex_);
+            index_.clear();
+            entries_.clear();
+        }
+
+        // Очищает кэш и меняет ёмкость; нельзя вызывать одновременно с Get и Put
+        void Reset(size_t capacity) {
+            Clear();
+            capacity_ = capacity;
+        }
+
+        size_t GetCapacity() const {
+            return capacity_;
+        }
+
+        size_t GetHitCount() const {
+            return hit_count_;
+        }
+
+        size_t GetMissCount() const {
+            return miss_count_;
+        }
+
+    private:
+        using Entry = std::pair<Key, Value>;
+
+        size_t capacity_;
+        mutable std::mutex mutex_;
+        mutable std::list<Entry> entries_;
+        std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index_;
+        mutable std::atomic<size_t> hit_count_ = 0;
+        mutable std::atomic<size_t> miss_count_ = 0;
+    };
+
+} // namespace util
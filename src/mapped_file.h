@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace util {
+
+    // Файл, отображённый в память только для чтения.
+    // На POSIX-системах используется mmap: страницы подгружаются по мере обращения,
+    // данные не копируются в кучу. На остальных платформах файл читается целиком в буфер.
+    class MappedFile {
+    public:
+        // Бросает std::runtime_error, если файл не удалось открыть или отобразить
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* GetData() const;
+        size_t GetSize() const;
+
+    private:
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+        bool is_mapped_ = false;
+        std::vector<char> buffer_;
+    };
+
+} // namespace util
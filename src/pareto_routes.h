@@ -0,0 +1,166 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace graph {
+
+// Путь из множества Парето по двум критериям: весу и числу рёбер, отмеченных функцией is_counted
+template <typename Weight>
+struct ParetoRouteInfo {
+    Weight weight;
+    size_t count;
+    std::vector<EdgeId> edges;
+};
+
+namespace detail {
+
+// Рабочие массивы многокритериального поиска. Переиспользуются между запросами одного потока,
+// перед новым поиском очищаются только наборы меток затронутых вершин.
+template <typename Weight>
+struct ParetoSpace {
+    static constexpr size_t NO_LABEL = std::numeric_limits<size_t>::max();
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+
+    struct Label {
+        Weight weight;
+        size_t count;
+        VertexId vertex;
+        EdgeId prev_edge;
+        size_t prev_label;
+        bool is_dominated;
+    };
+
+    using HeapItem = std::tuple<Weight, size_t, size_t>;  // вес, счётчик, номер метки
+
+    std::vector<Label> labels;
+    std::vector<std::vector<size_t>> bags;  // по вершинам: номера недоминируемых меток
+    std::vector<VertexId> touched;
+    std::vector<HeapItem> heap;
+
+    void Prepare(size_t vertex_count) {
+        for (const VertexId vertex : touched) {
+            bags[vertex].clear();
+        }
+        touched.clear();
+        labels.clear();
+        heap.clear();
+        if (bags.size() < vertex_count) {
+            bags.resize(vertex_count);
+        }
+    }
+
+    // Метка (weight, count) доминируется набором вершины, если в нём есть метка не хуже по обоим критериям
+    bool IsDominated(VertexId vertex, Weight weight, size_t count) const {
+        for (const size_t label_index : bags[vertex]) {
+            const Label& label = labels[label_index];
+            if (!(weight < label.weight) && label.count <= count) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Добавляет метку в набор вершины, вытесняя метки, которые она доминирует
+    void AddLabel(VertexId vertex, Weight weight, size_t count, EdgeId prev_edge, size_t prev_label) {
+        std::vector<size_t>& bag = bags[vertex];
+        if (bag.empty()) {
+            touched.push_back(vertex);
+        }
+        bag.erase(std::remove_if(bag.begin(), bag.end(),
+                                 [&](size_t label_index) {
+                                     Label& label = labels[label_index];
+                                     label.is_dominated = !(label.weight < weight) && count <= label.count;
+                                     return label.is_dominated;
+                                 }),
+                  bag.end());
+        bag.push_back(labels.size());
+        labels.push_back(Label{weight, count, vertex, prev_edge, prev_label, false});
+        heap.emplace_back(weight, count, bag.back());
+        std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+    }
+
+    HeapItem PopHeap() {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+        const HeapItem item = heap.back();
+        heap.pop_back();
+        return item;
+    }
+};
+
+template <typename Weight>
+ParetoSpace<Weight>& GetParetoSpace(size_t vertex_count) {
+    static thread_local ParetoSpace<Weight> pareto_space;
+    pareto_space.Prepare(vertex_count);
+    return pareto_space;
+}
+
+}  // namespace detail
+
+// Множество Парето путей из from в to по весу и числу рёбер, для которых is_counted(edge_id) истинно;
+// пути упорядочены по возрастанию веса (и, значит, по убыванию счётчика).
+// Многокритериальный Дейкстра: у каждой вершины набор недоминируемых меток, метки извлекаются
+// в лексикографическом порядке (вес, счётчик). Новая метка отбрасывается, если её доминирует набор
+// её вершины или набор цели - оба критерия вдоль пути только растут, поэтому наборы остаются
+// небольшими: не больше числа различных значений счётчика.
+template <typename Weight, typename CountPredicate>
+std::vector<ParetoRouteInfo<Weight>> BuildParetoRoutes(const DirectedWeightedGraph<Weight>& graph, VertexId from, VertexId to,
+                                                       CountPredicate is_counted) {
+    using ParetoSpace = detail::ParetoSpace<Weight>;
+
+    if (!graph.IsFrozen()) {
+        throw std::invalid_argument("Graph should be frozen");
+    }
+    const size_t vertex_count = graph.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    ParetoSpace& space = detail::GetParetoSpace<Weight>(vertex_count);
+    space.AddLabel(from, Weight{}, 0, ParetoSpace::NO_EDGE, ParetoSpace::NO_LABEL);
+    while (!space.heap.empty()) {
+        const size_t label_index = std::get<2>(space.PopHeap());
+        const auto label = space.labels[label_index];
+        if (label.is_dominated || label.vertex == to) {
+            continue;
+        }
+        for (const auto& edge : graph.GetOutgoingEdges(label.vertex)) {
+            const EdgeId edge_id = graph.GetEdgeId(edge);
+            if (!graph.IsEdgeEnabled(edge_id)) {
+                continue;
+            }
+            const Weight weight = label.weight + edge.weight;
+            const size_t count = label.count + (is_counted(edge_id) ? 1 : 0);
+            if (space.IsDominated(to, weight, count) || space.IsDominated(edge.to, weight, count)) {
+                continue;
+            }
+            space.AddLabel(edge.to, weight, count, edge_id, label_index);
+        }
+    }
+
+    std::vector<ParetoRouteInfo<Weight>> routes;
+    for (const size_t target_label_index : space.bags[to]) {
+        const auto& target_label = space.labels[target_label_index];
+        std::vector<EdgeId> edges;
+        for (size_t label_index = target_label_index; space.labels[label_index].prev_label != ParetoSpace::NO_LABEL;
+             label_index = space.labels[label_index].prev_label)
+        {
+            edges.push_back(space.labels[label_index].prev_edge);
+        }
+        std::reverse(edges.begin(), edges.end());
+        routes.push_back(ParetoRouteInfo<Weight>{target_label.weight, target_label.count, std::move(edges)});
+    }
+    std::sort(routes.begin(), routes.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.weight < rhs.weight;
+    });
+    return routes;
+}
+
+}  // namespace graph
@@ -0,0 +1,396 @@
+#include "raptor_router.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace tc::router {
+
+	namespace {
+		constexpr double INFINITE_TIME = std::numeric_limits<double>::infinity();
+	}
+
+	RaptorRouter::RaptorRouter(const TransportCatalogue& transport_catalogue, const RoutingSettings& settings) :
+		transport_catalogue_(transport_catalogue),
+		bus_wait_time_(settings.bus_wait_time),
+		bus_velocity_(settings.bus_velocity),
+		closed_stops_(transport_catalogue.GetAllStops().size(), 0),
+		suspended_buses_(transport_catalogue.GetAllBuses().size(), 0) {
+		for (const Stop& stop : transport_catalogue_.GetAllStops()) {
+			stops_.push_back(&stop);
+		}
+
+		// направления те же, что в графе: кольцевой маршрут целиком, некольцевой - две половины
+		for (const Bus& bus : transport_catalogue_.GetAllBuses()) {
+			if (bus.is_roundtrip) {
+				AddPattern(&bus, bus.stops.cbegin(), bus.stops.cend());
+			}
+			else {
+				auto end_stop_ptr_it = bus.stops.cbegin() + bus.stops.size() / 2;
+				AddPattern(&bus, bus.stops.cbegin(), end_stop_ptr_it + 1);
+				AddPattern(&bus, end_stop_ptr_it, bus.stops.cend());
+			}
+		}
+
+		// индекс "остановка -> направления" в виде смещений в одном массиве
+		stop_pattern_offsets_.assign(stops_.size() + 1, 0);
+		for (const size_t stop_index : pattern_stops_) {
+			++stop_pattern_offsets_[stop_index + 1];
+		}
+		for (size_t i = 1; i < stop_pattern_offsets_.size(); ++i) {
+			stop_pattern_offsets_[i] += stop_pattern_offsets_[i - 1];
+		}
+		stop_patterns_.resize(pattern_stops_.size());
+		std::vector<size_t> fill_positions(stop_pattern_offsets_.begin(), stop_pattern_offsets_.end() - 1);
+		for (size_t pattern_index = 0; pattern_index < patterns_.size(); ++pattern_index) {
+			const Pattern& pattern = patterns_[pattern_index];
+			for (size_t position = 0; position < pattern.stop_count; ++position) {
+				const size_t stop_index = pattern_stops_[pattern.first_position + position];
+				stop_patterns_[fill_positions[stop_index]++] = { pattern_index, position };
+			}
+		}
+
+		// пешие переходы в обе стороны тем же индексом смещений
+		stop_walk_offsets_.assign(stops_.size() + 1, 0);
+		if (settings.walk_radius > 0.0) {
+			const double velocity_coefficient = 60.0 / 1000.0;
+			const std::vector<NearbyStops> nearby_stops = transport_catalogue_.FindNearbyStops(settings.walk_radius);
+			for (const NearbyStops& stops : nearby_stops) {
+				++stop_walk_offsets_[stops.first->id + 1];
+				++stop_walk_offsets_[stops.second->id + 1];
+			}
+			for (size_t i = 1; i < stop_walk_offsets_.size(); ++i) {
+				stop_walk_offsets_[i] += stop_walk_offsets_[i - 1];
+			}
+			stop_walks_.resize(nearby_stops.size() * 2);
+			std::vector<size_t> walk_fill_positions(stop_walk_offsets_.begin(), stop_walk_offsets_.end() - 1);
+			for (const NearbyStops& stops : nearby_stops) {
+				const double walk_time = stops.distance / settings.walk_velocity * velocity_coefficient;
+				stop_walks_[walk_fill_positions[stops.first->id]++] = { stops.second->id, walk_time };
+				stop_walks_[walk_fill_positions[stops.second->id]++] = { stops.first->id, walk_time };
+			}
+		}
+	}
+
+	template <typename ConstIt>
+	void RaptorRouter::AddPattern(BusPtr bus, ConstIt stop_ptr_begin, ConstIt stop_ptr_end) {
+		const double velocity_coefficient = 60.0 / 1000.0;
+
+		Pattern pattern{ bus, pattern_stops_.size(), static_cast<size_t>(stop_ptr_end - stop_ptr_begin) };
+		// расстояния от начала маршрута автобуса; направление может начинаться с его середины
+		const int* distances = transport_catalogue_.GetRouteDistances(bus).data() + (stop_ptr_begin - bus->stops.cbegin());
+		for (ConstIt stop_it = stop_ptr_begin; stop_it != stop_ptr_end; ++stop_it) {
+			const int distance = distances[stop_it - stop_ptr_begin] - distances[0];
+			pattern_stops_.push_back((*stop_it)->id);
+			pattern_times_.push_back(distance / bus_velocity_ * velocity_coefficient);
+		}
+		patterns_.push_back(pattern);
+	}
+
+	RaptorRouter::SearchSpace& RaptorRouter::GetSearchSpace() {
+		static thread_local SearchSpace space;
+		return space;
+	}
+
+	void RaptorRouter::SearchSpace::Reset(size_t stop_count, size_t pattern_count) {
+		for (size_t round = 0; round < improved_stops.size(); ++round) {
+			for (const size_t stop_index : improved_stops[round]) {
+				labels[round][stop_index] = INFINITE_TIME;
+				rides[round][stop_index] = Ride{};
+				best_labels[stop_index] = INFINITE_TIME;
+			}
+			improved_stops[round].clear();
+		}
+		for (const size_t stop_index : marked_stop_list) {
+			marked_stops[stop_index] = 0;
+		}
+		marked_stop_list.clear();
+		queued_patterns.clear();
+
+		// после сброса все элементы в исходном состоянии, поэтому при смене справочника достаточно изменить размер
+		if (best_labels.size() != stop_count) {
+			best_labels.assign(stop_count, INFINITE_TIME);
+			marked_stops.assign(stop_count, 0);
+			for (size_t round = 0; round < labels.size(); ++round) {
+				labels[round].assign(stop_count, INFINITE_TIME);
+				rides[round].assign(stop_count, Ride{});
+			}
+		}
+		if (pattern_starts.size() != pattern_count) {
+			pattern_starts.assign(pattern_count, NO_POSITION);
+		}
+	}
+
+	void RaptorRouter::SearchSpace::PrepareRound(size_t round, size_t stop_count) {
+		if (labels.size() <= round) {
+			labels.emplace_back(stop_count, INFINITE_TIME);
+			rides.emplace_back(stop_count, Ride{});
+			improved_stops.emplace_back();
+		}
+	}
+
+	void RaptorRouter::SearchSpace::Improve(size_t round, size_t stop_index, double time, const Ride& ride) {
+		if (labels[round][stop_index] == INFINITE_TIME) {
+			improved_stops[round].push_back(stop_index);
+		}
+		labels[round][stop_index] = time;
+		rides[round][stop_index] = ride;
+		best_labels[stop_index] = time;
+		if (!marked_stops[stop_index]) {
+			marked_stops[stop_index] = 1;
+			marked_stop_list.push_back(stop_index);
+		}
+	}
+
+	size_t RaptorRouter::RunRounds(SearchSpace& space, size_t stop_from_index, size_t stop_to_index) const {
+		const size_t stop_count = stops_.size();
+		space.Reset(stop_count, patterns_.size());
+		space.PrepareRound(0, stop_count);
+		space.Improve(0, stop_from_index, 0.0, Ride{});
+		RelaxWalks(space, 0, stop_to_index);
+
+		// остановки, отмеченные в прошлом раунде; их метки прошлого раунда заданы
+		std::vector<size_t>& scanned_stops = space.scanned_stops;
+		size_t last_round = 0;
+		for (size_t round = 1;; ++round) {
+			// направления через отмеченные остановки, с самой ранней отмеченной позиции
+			scanned_stops.swap(space.marked_stop_list);
+			space.marked_stop_list.clear();
+			for (const size_t stop_index : scanned_stops) {
+				space.marked_stops[stop_index] = 0;
+				for (size_t i = stop_pattern_offsets_[stop_index]; i < stop_pattern_offsets_[stop_index + 1]; ++i) {
+					const auto [pattern_index, position] = stop_patterns_[i];
+					if (suspended_buses_[patterns_[pattern_index].bus->id]) {
+						continue;
+					}
+					size_t& start = space.pattern_starts[pattern_index];
+					if (start == NO_POSITION) {
+						space.queued_patterns.push_back(pattern_index);
+					}
+					start = std::min(start, position);
+				}
+			}
+			if (space.queued_patterns.empty()) {
+				break;
+			}
+
+			// посадка только на остановках, улучшенных в прошлом раунде: с остальных она уже просмотрена
+			// в раунде после их улучшения и лучших меток не даст
+			space.PrepareRound(round, stop_count);
+			const std::vector<double>& prev_labels = space.labels[round - 1];
+
+			for (const size_t pattern_index : space.queued_patterns) {
+				const Pattern& pattern = patterns_[pattern_index];
+				const size_t* stop_indices = &pattern_stops_[pattern.first_position];
+				const double* times = &pattern_times_[pattern.first_position];
+
+				size_t board_position = NO_POSITION;
+				double board_time = INFINITE_TIME;	// время прибытия на остановку посадки плюс ожидание
+				for (size_t position = space.pattern_starts[pattern_index]; position < pattern.stop_count; ++position) {
+					const size_t stop_index = stop_indices[position];
+					// закрытую остановку автобус проезжает: ни высадки, ни посадки
+					if (closed_stops_[stop_index]) {
+						continue;
+					}
+					double arrival_time = INFINITE_TIME;
+					if (board_position != NO_POSITION) {
+						arrival_time = board_time + (times[position] - times[board_position]);
+						// целевая остановка ограничивает все остальные
+						const double bound_time = stop_to_index == NO_POSITION ? INFINITE_TIME : space.best_labels[stop_to_index];
+						if (arrival_time < space.best_labels[stop_index] && arrival_time < bound_time) {
+							space.Improve(round, stop_index, arrival_time, Ride{ pattern_index, board_position, position });
+							last_round = round;
+						}
+					}
+					if (position + 1 < pattern.stop_count && prev_labels[stop_index] + bus_wait_time_ < arrival_time) {
+						board_position = position;
+						board_time = prev_labels[stop_index] + bus_wait_time_;
+					}
+				}
+				space.pattern_starts[pattern_index] = NO_POSITION;
+			}
+			space.queued_patterns.clear();
+
+			if (RelaxWalks(space, round, stop_to_index)) {
+				last_round = round;
+			}
+		}
+		return last_round;
+	}
+
+	bool RaptorRouter::RelaxWalks(SearchSpace& space, size_t round, size_t stop_to_index) const {
+		if (stop_walks_.empty()) {
+			return false;
+		}
+		const std::vector<double>& labels = space.labels[round];
+		std::vector<std::pair<double, size_t>>& heap = space.walk_heap;
+		const auto heap_compare = std::greater<std::pair<double, size_t>>{};
+
+		// отмечены ровно улучшенные в этом раунде остановки
+		heap.clear();
+		for (const size_t stop_index : space.marked_stop_list) {
+			heap.emplace_back(labels[stop_index], stop_index);
+		}
+		std::make_heap(heap.begin(), heap.end(), heap_compare);
+
+		bool is_improved = false;
+		while (!heap.empty()) {
+			std::pop_heap(heap.begin(), heap.end(), heap_compare);
+			const auto [time, stop_index] = heap.back();
+			heap.pop_back();
+			if (time > labels[stop_index] || closed_stops_[stop_index]) {
+				continue;
+			}
+			for (size_t i = stop_walk_offsets_[stop_index]; i < stop_walk_offsets_[stop_index + 1]; ++i) {
+				const auto [walk_stop_index, walk_time] = stop_walks_[i];
+				if (closed_stops_[walk_stop_index]) {
+					continue;
+				}
+				const double arrival_time = time + walk_time;
+				const double bound_time = stop_to_index == NO_POSITION ? INFINITE_TIME : space.best_labels[stop_to_index];
+				if (arrival_time < space.best_labels[walk_stop_index] && arrival_time < bound_time) {
+					Ride walk_ride;
+					walk_ride.walk_from = stop_index;
+					space.Improve(round, walk_stop_index, arrival_time, walk_ride);
+					heap.emplace_back(arrival_time, walk_stop_index);
+					std::push_heap(heap.begin(), heap.end(), heap_compare);
+					is_improved = true;
+				}
+			}
+		}
+		return is_improved;
+	}
+
+	void RaptorRouter::SetDisruptions(std::vector<char> closed_stops, std::vector<char> suspended_buses) {
+		closed_stops_ = std::move(closed_stops);
+		suspended_buses_ = std::move(suspended_buses);
+	}
+
+	double RaptorRouter::GetWalkTime(size_t stop_from_index, size_t stop_to_index) const {
+		for (size_t i = stop_walk_offsets_[stop_from_index]; i < stop_walk_offsets_[stop_from_index + 1]; ++i) {
+			if (stop_walks_[i].first == stop_to_index) {
+				return stop_walks_[i].second;
+			}
+		}
+		return INFINITE_TIME;
+	}
+
+	Route RaptorRouter::BuildRoute(SearchSpace& space, size_t round, size_t stop_from_index, size_t stop_to_index) const {
+		Route route;
+		BuildRoute(space, round, stop_from_index, stop_to_index, route);
+		return route;
+	}
+
+	void RaptorRouter::BuildRoute(SearchSpace& space, size_t round, size_t stop_from_index, size_t stop_to_index, Route& route) const {
+		// время цели - из последнего раунда не позже round, в котором она улучшена
+		while (round > 0 && space.labels[round][stop_to_index] == INFINITE_TIME) {
+			--round;
+		}
+		route.total_time = space.labels[round][stop_to_index];
+		route.items.clear();
+
+		// восстанавливаем поездки с конца: в каждом раунде не более одной, после неё - пешие переходы
+		// того же раунда
+		std::vector<std::pair<size_t, Ride>>& rides = space.route_rides;
+		rides.clear();
+		size_t stop_index = stop_to_index;
+		while (stop_index != stop_from_index) {
+			const Ride& ride = space.rides[round][stop_index];
+			if (ride.walk_from != NO_POSITION) {
+				rides.emplace_back(stop_index, ride);
+				stop_index = ride.walk_from;
+				continue;
+			}
+			if (ride.pattern != NO_POSITION) {
+				rides.emplace_back(stop_index, ride);
+				stop_index = pattern_stops_[patterns_[ride.pattern].first_position + ride.board_position];
+			}
+			--round;
+		}
+
+		for (auto it = rides.rbegin(); it != rides.rend(); ++it) {
+			const auto& [alight_stop_index, ride] = *it;
+			if (ride.walk_from != NO_POSITION) {
+				route.items.push_back(RouteItem::Walk(stops_[ride.walk_from]->name, stops_[alight_stop_index]->name, GetWalkTime(ride.walk_from, alight_stop_index)));
+				continue;
+			}
+			const Pattern& pattern = patterns_[ride.pattern];
+			const size_t board_stop_index = pattern_stops_[pattern.first_position + ride.board_position];
+			const double ride_time = pattern_times_[pattern.first_position + ride.alight_position] - pattern_times_[pattern.first_position + ride.board_position];
+			route.items.push_back(RouteItem::Wait(stops_[board_stop_index]->name, bus_wait_time_));
+			route.items.push_back(RouteItem::Bus(pattern.bus->name, ride_time, static_cast<int>(ride.alight_position - ride.board_position)));
+		}
+	}
+
+	size_t RaptorRouter::GetStopIndex(StopPtr stop) const {
+		// GetStop возвращает nullptr для неизвестного названия
+		if (stop == nullptr || stop->id >= stops_.size()) {
+			throw std::out_of_range("Unknown stop");
+		}
+		return stop->id;
+	}
+
+	bool RaptorRouter::FindRoute(StopPtr stop_from, StopPtr stop_to, Route& route) const {
+		SearchSpace& space = GetSearchSpace();
+
+		const size_t stop_from_index = GetStopIndex(stop_from);
+		const size_t stop_to_index = GetStopIndex(stop_to);
+		const size_t last_round = RunRounds(space, stop_from_index, stop_to_index);
+		if (space.best_labels[stop_to_index] == INFINITE_TIME) {
+			return false;
+		}
+		BuildRoute(space, last_round, stop_from_index, stop_to_index, route);
+		return true;
+	}
+
+	std::vector<ParetoRoute> RaptorRouter::FindParetoRoutes(StopPtr stop_from, StopPtr stop_to) const {
+		SearchSpace& space = GetSearchSpace();
+
+		const size_t stop_from_index = GetStopIndex(stop_from);
+		const size_t stop_to_index = GetStopIndex(stop_to);
+		const size_t last_round = RunRounds(space, stop_from_index, stop_to_index);
+
+		// раунды с улучшением цели идут по убыванию времени; результат - по возрастанию
+		std::vector<ParetoRoute> routes;
+		double best_time = INFINITE_TIME;
+		for (size_t round = 0; round <= last_round; ++round) {
+			const double time = space.labels[round][stop_to_index];
+			if (time < best_time) {
+				best_time = time;
+				const int transfer_count = round > 0 ? static_cast<int>(round) - 1 : 0;
+				// пеший маршрут нулевого раунда вытесняется более быстрым маршрутом с одной поездкой
+				if (!routes.empty() && routes.back().transfer_count == transfer_count) {
+					routes.pop_back();
+				}
+				routes.push_back({ BuildRoute(space, round, stop_from_index, stop_to_index), transfer_count });
+			}
+		}
+		std::reverse(routes.begin(), routes.end());
+		return routes;
+	}
+
+	std::vector<std::optional<Route>> RaptorRouter::FindRoutes(StopPtr stop_from, const std::vector<StopPtr>& stops_to) const {
+		SearchSpace& space = GetSearchSpace();
+
+		const size_t stop_from_index = GetStopIndex(stop_from);
+		const size_t last_round = RunRounds(space, stop_from_index, NO_POSITION);
+
+		// поездки остановки записываются только при улучшении, поэтому восстановление
+		// с последнего раунда даёт лучший маршрут для любой цели
+		std::vector<std::optional<Route>> routes;
+		routes.reserve(stops_to.size());
+		for (StopPtr stop_to : stops_to) {
+			const size_t stop_to_index = GetStopIndex(stop_to);
+			if (space.best_labels[stop_to_index] == INFINITE_TIME) {
+				routes.emplace_back(std::nullopt);
+			}
+			else {
+				routes.emplace_back(BuildRoute(space, last_round, stop_from_index, stop_to_index));
+			}
+		}
+		return routes;
+	}
+
+} // namespace tc::router
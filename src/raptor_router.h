@@ -0,0 +1,105 @@
+#pragma once
+
+#include "domain.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <optional>
+#include <vector>
+
+namespace tc::router {
+
+	// Поиск маршрута по раундам в духе RAPTOR прямо по маршрутам справочника, без графа.
+	// Раунд k находит лучшие времена прибытия на остановки не более чем с k поездками:
+	// просматриваются только направления автобусов, проходящие через улучшенные в прошлом раунде
+	// остановки, последовательно по массиву остановок направления.
+	// Стоимость та же, что в графе: bus_wait_time на каждую посадку плюс время в пути при bus_velocity.
+	// Пешие переходы между близкими остановками просматриваются в конце каждого раунда поиском
+	// Дейкстры от улучшенных в нём остановок; переход поездкой не считается и раунд не увеличивает.
+	class RaptorRouter {
+	public:
+		RaptorRouter(const TransportCatalogue& transport_catalogue, const RoutingSettings& settings);
+
+		// Записывает маршрут в route, переиспользуя его память; false - маршрута нет
+		bool FindRoute(StopPtr stop_from, StopPtr stop_to, Route& route) const;
+		// Маршруты из одной остановки во все stops_to за один проход раундов
+		std::vector<std::optional<Route>> FindRoutes(StopPtr stop_from, const std::vector<StopPtr>& stops_to) const;
+		// Раунд k даёт лучшее время не более чем с k поездками, поэтому раунды, улучшившие цель,
+		// и есть множество Парето по времени и числу пересадок
+		std::vector<ParetoRoute> FindParetoRoutes(StopPtr stop_from, StopPtr stop_to) const;
+		// Закрытые остановки (по Stop::id) исключаются из посадок, высадок и пеших переходов,
+		// направления приостановленных автобусов (по Bus::id) не просматриваются
+		void SetDisruptions(std::vector<char> closed_stops, std::vector<char> suspended_buses);
+
+	private:
+		static constexpr size_t NO_POSITION = static_cast<size_t>(-1);
+
+		// Направление автобуса: отрезок [first_position, first_position + stop_count) массивов pattern_*
+		struct Pattern {
+			BusPtr bus;
+			size_t first_position;
+			size_t stop_count;
+		};
+
+		// Поездка, которой остановка улучшена в раунде
+		struct Ride {
+			size_t pattern = NO_POSITION;
+			size_t board_position = NO_POSITION;
+			size_t alight_position = NO_POSITION;
+			size_t walk_from = NO_POSITION;	// вместо поездки - пеший переход от этой остановки в том же раунде
+		};
+
+		// Рабочие массивы запроса; переиспользуются между запросами одного потока.
+		// labels и rides раунда заполнены только для улучшенных в нём остановок, остальные - бесконечность
+		// и пустая поездка; после запроса сбрасываются только записанные элементы, поэтому раунд
+		// обходится за время, пропорциональное числу отмеченных остановок и просмотренных направлений.
+		struct SearchSpace {
+			std::vector<std::vector<double>> labels;	// по раундам: время прибытия на улучшенную в раунде остановку
+			std::vector<std::vector<Ride>> rides;	// по раундам: поездка, улучшившая остановку
+			std::vector<std::vector<size_t>> improved_stops;	// по раундам: остановки, улучшенные в раунде
+			std::vector<double> best_labels;
+			std::vector<char> marked_stops;
+			std::vector<size_t> marked_stop_list;	// отмеченные остановки в порядке отметки
+			std::vector<size_t> scanned_stops;	// отмеченные в прошлом раунде, направления через них просматриваются
+			std::vector<size_t> pattern_starts;	// самая ранняя отмеченная позиция в направлении
+			std::vector<size_t> queued_patterns;
+			std::vector<std::pair<double, size_t>> walk_heap;	// (время прибытия, остановка)
+			std::vector<std::pair<size_t, Ride>> route_rides;	// поездки и переходы восстанавливаемого маршрута с остановками прибытия
+
+			// Сбрасывает метки прошлого запроса и подгоняет массивы под размер справочника
+			void Reset(size_t stop_count, size_t pattern_count);
+			// Готовит массивы раунда; раунды появляются по мере надобности
+			void PrepareRound(size_t round, size_t stop_count);
+			void Improve(size_t round, size_t stop_index, double time, const Ride& ride);
+		};
+
+		template <typename ConstIt>
+		void AddPattern(BusPtr bus, ConstIt stop_ptr_begin, ConstIt stop_ptr_end);
+
+		static SearchSpace& GetSearchSpace();
+		// Stop::id остановки; для nullptr и чужой остановки бросает std::out_of_range
+		size_t GetStopIndex(StopPtr stop) const;
+		// stop_to_index == NO_POSITION - без отсечения по целевой остановке
+		size_t RunRounds(SearchSpace& space, size_t stop_from_index, size_t stop_to_index) const;
+		// Пешие переходы от отмеченных в раунде остановок; true, если какая-то остановка улучшена
+		bool RelaxWalks(SearchSpace& space, size_t round, size_t stop_to_index) const;
+		double GetWalkTime(size_t stop_from_index, size_t stop_to_index) const;
+		void BuildRoute(SearchSpace& space, size_t round, size_t stop_from_index, size_t stop_to_index, Route& route) const;
+		Route BuildRoute(SearchSpace& space, size_t round, size_t stop_from_index, size_t stop_to_index) const;
+
+		const TransportCatalogue& transport_catalogue_;
+		double bus_wait_time_;
+		double bus_velocity_;
+		std::vector<StopPtr> stops_;	// по Stop::id
+		std::vector<Pattern> patterns_;
+		std::vector<size_t> pattern_stops_;	// индексы остановок направлений подряд
+		std::vector<double> pattern_times_;	// время в пути от начала направления до остановки
+		std::vector<size_t> stop_pattern_offsets_;	// направления остановки i: stop_patterns_[offsets[i], offsets[i + 1])
+		std::vector<std::pair<size_t, size_t>> stop_patterns_;	// (направление, позиция в нём)
+		std::vector<size_t> stop_walk_offsets_;	// пешие переходы от остановки i: stop_walks_[offsets[i], offsets[i + 1])
+		std::vector<std::pair<size_t, double>> stop_walks_;	// (остановка назначения, время пешком)
+		std::vector<char> closed_stops_;
+		std::vector<char> suspended_buses_;
+	};
+
+} // namespace tc::router
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "graph.h"
+#include "search_space.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <iterator>
@@ -14,20 +16,81 @@
 
 namespace graph {
 
+// Общий интерфейс движков поиска маршрутов в графе
 template <typename Weight>
-class Router {
+class RouterBase {
+public:
+    struct RouteInfo {
+        Weight weight;
+        std::vector<EdgeId> edges;
+    };
+
+    virtual ~RouterBase() = default;
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const {
+        RouteInfo route_info{};
+        if (!FillRoute(from, to, route_info)) {
+            return std::nullopt;
+        }
+        return route_info;
+    }
+
+    // Записывает маршрут в route_info, переиспользуя память его массива рёбер: при повторных запросах
+    // в тот же route_info память не выделяется. Возвращает false, если маршрута нет.
+    virtual bool FillRoute(VertexId from, VertexId to, RouteInfo& route_info) const = 0;
+
+    // Маршруты из одной вершины во все вершины targets, в том же порядке.
+    // По умолчанию - отдельный запрос на каждую цель; движки с поиском по запросу
+    // переопределяют метод и строят одно дерево кратчайших путей на все цели.
+    virtual std::vector<std::optional<RouteInfo>> BuildRoutes(VertexId from, const std::vector<VertexId>& targets) const {
+        std::vector<std::optional<RouteInfo>> routes;
+        routes.reserve(targets.size());
+        for (const VertexId to : targets) {
+            routes.push_back(BuildRoute(from, to));
+        }
+        return routes;
+    }
+
+    // Обновляет предрасчёт после включения или отключения рёбер edge_ids маской графа.
+    // Поиск по запросу видит маску сразу, поэтому по умолчанию ничего не делается.
+    // Нельзя вызывать одновременно с поиском маршрутов.
+    virtual void UpdateEdges(const std::vector<EdgeId>& /*edge_ids*/) {
+    }
+
+    // Суммарное число вершин, извлечённых из кучи при ответах на запросы (0 для движков с таблицей)
+    size_t GetSettledVertexCount() const {
+        return settled_vertex_count_;
+    }
+
+protected:
+    void AddSettledVertices(size_t count) const {
+        settled_vertex_count_ += count;
+    }
+
+private:
+    mutable std::atomic<size_t> settled_vertex_count_ = 0;
+};
+
+// Предрасчёт кратчайших путей между всеми парами вершин (Флойд-Уоршелл)
+template <typename Weight>
+class Router : public RouterBase<Weight> {
 private:
     using Graph = DirectedWeightedGraph<Weight>;
 
 public:
+    using typename RouterBase<Weight>::RouteInfo;
+
     explicit Router(const Graph& graph);
 
-    struct RouteInfo {
-        Weight weight;
-        std::vector<EdgeId> edges;
-    };
+    bool FillRoute(VertexId from, VertexId to, RouteInfo& route_info) const override;
+    // Пересчитывает поиском Дейкстры только строки таблицы, которые изменение маски может затронуть
+    void UpdateEdges(const std::vector<EdgeId>& edge_ids) override;
 
-    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    // Память таблицы всех пар для графа из vertex_count вершин, в байтах
+    static size_t EstimateMemory(size_t vertex_count) {
+        return vertex_count * (vertex_count * sizeof(std::optional<RouteInternalData>)
+                               + sizeof(std::vector<std::optional<RouteInternalData>>));
+    }
 
 private:
     struct RouteInternalData {
@@ -40,11 +103,14 @@ private:
         const size_t vertex_count = graph.GetVertexCount();
         for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
             routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
-            for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
-                const auto& edge = graph.GetEdge(edge_id);
+            for (const auto& edge : graph.GetOutgoingEdges(vertex)) {
+                const EdgeId edge_id = graph.GetEdgeId(edge);
                 if (edge.weight < ZERO_WEIGHT) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
+                if (!graph.IsEdgeEnabled(edge_id)) {
+                    continue;
+                }
                 auto& route_internal_data = routes_internal_data_[vertex][edge.to];
                 if (!route_internal_data || route_internal_data->weight > edge.weight) {
                     route_internal_data = RouteInternalData{edge.weight, edge_id};
@@ -75,6 +141,36 @@ private:
         }
     }
 
+    // Строка from - дерево кратчайших путей из from. Отключённое ребро затрагивает строку, если входит в дерево,
+    // включённое - если сокращает путь до своего конца.
+    bool IsRowAffected(VertexId from, const std::vector<EdgeId>& edge_ids) const {
+        const auto& row = routes_internal_data_[from];
+        for (const EdgeId edge_id : edge_ids) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            if (!graph_.IsEdgeEnabled(edge_id)) {
+                if (row[edge.to] && row[edge.to]->prev_edge == edge_id) {
+                    return true;
+                }
+            }
+            else if (row[edge.from] && (!row[edge.to] || row[edge.from]->weight + edge.weight < row[edge.to]->weight)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void RebuildRow(VertexId from) {
+        auto& space = detail::GetSearchSpace<Weight>(graph_.GetVertexCount());
+        detail::BuildShortestPathTree(graph_, space, from);
+        auto& row = routes_internal_data_[from];
+        std::fill(row.begin(), row.end(), std::nullopt);
+        for (const VertexId vertex : space.touched) {
+            const EdgeId prev_edge = space.prev_edges[vertex];
+            row[vertex] = RouteInternalData{space.weights[vertex],
+                                            prev_edge == detail::SearchSpace<Weight>::NO_EDGE ? std::nullopt : std::optional{prev_edge}};
+        }
+    }
+
     static constexpr Weight ZERO_WEIGHT{};
     const Graph& graph_;
     RoutesInternalData routes_internal_data_;
@@ -86,6 +182,9 @@ Router<Weight>::Router(const Graph& graph)
     , routes_internal_data_(graph.GetVertexCount(),
                             std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
 {
+    if (!graph.IsFrozen()) {
+        throw std::invalid_argument("Graph should be frozen");
+    }
     InitializeRoutesInternalData(graph);
 
     const size_t vertex_count = graph.GetVertexCount();
@@ -95,14 +194,26 @@ Router<Weight>::Router(const Graph& graph)
 }
 
 template <typename Weight>
-std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
-                                                                             VertexId to) const {
+void Router<Weight>::UpdateEdges(const std::vector<EdgeId>& edge_ids) {
+    if (edge_ids.empty()) {
+        return;
+    }
+    for (VertexId from = 0; from < graph_.GetVertexCount(); ++from) {
+        if (IsRowAffected(from, edge_ids)) {
+            RebuildRow(from);
+        }
+    }
+}
+
+template <typename Weight>
+bool Router<Weight>::FillRoute(VertexId from, VertexId to, RouteInfo& route_info) const {
     const auto& route_internal_data = routes_internal_data_.at(from).at(to);
     if (!route_internal_data) {
-        return std::nullopt;
+        return false;
     }
-    const Weight weight = route_internal_data->weight;
-    std::vector<EdgeId> edges;
+    route_info.weight = route_internal_data->weight;
+    std::vector<EdgeId>& edges = route_info.edges;
+    edges.clear();
     for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
          edge_id;
          edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
@@ -111,7 +222,7 @@ std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(Ver
     }
     std::reverse(edges.begin(), edges.end());
 
-    return RouteInfo{weight, std::move(edges)};
+    return true;
 }
 
 }  // namespace graph
\ No newline at end of file
@@ -0,0 +1,330 @@
+#include "compact_router.h"
+#include "mapped_file.h"
+#include "router_snapshot.h"
+#include "transport_router.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace tc::router {
+
+	namespace snapshot {
+
+		namespace {
+
+			class Fnv1aHasher {
+			public:
+				void Add(const void* data, size_t size) {
+					const unsigned char* bytes = static_cast<const unsigned char*>(data);
+					for (size_t i = 0; i < size; ++i) {
+						hash_ = (hash_ ^ bytes[i]) * 1099511628211ull;
+					}
+				}
+
+				template <typename T>
+				void AddValue(T value) {
+					Add(&value, sizeof(value));
+				}
+
+				void AddString(std::string_view str) {
+					AddValue<uint64_t>(str.size());
+					Add(str.data(), str.size());
+				}
+
+				uint64_t Get() const {
+					return hash_;
+				}
+
+			private:
+				uint64_t hash_ = 14695981039346656037ull;
+			};
+
+			size_t AlignOffset(size_t offset) {
+				return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+			}
+
+			// Проверяет, что секция из count записей типа T помещается в файл
+			template <typename T>
+			bool IsSectionValid(const Header& header, uint64_t offset, uint64_t count) {
+				return offset % SECTION_ALIGNMENT == 0 && offset <= header.file_size
+					&& count <= (header.file_size - offset) / sizeof(T);
+			}
+
+			// Проверяет, что записи ссылаются только на существующие вершины, рёбра, остановки и автобусы,
+			// а рёбра отсортированы по вершине начала, как в замороженном графе
+			bool AreRecordsValid(const Header& header, const char* data, size_t bus_count) {
+				const auto* stop_vertices = reinterpret_cast<const StopVertices*>(data + header.stop_vertices_offset);
+				for (size_t stop_index = 0; stop_index < header.stop_count; ++stop_index) {
+					if (stop_vertices[stop_index].hub >= header.vertex_count || stop_vertices[stop_index].terminal >= header.vertex_count) {
+						return false;
+					}
+				}
+				const auto* vertex_stops = reinterpret_cast<const uint32_t*>(data + header.vertex_stops_offset);
+				for (size_t vertex = 0; vertex < header.vertex_count; ++vertex) {
+					if (vertex_stops[vertex] >= header.stop_count) {
+						return false;
+					}
+				}
+				const auto* edges = reinterpret_cast<const EdgeRecord*>(data + header.edges_offset);
+				const auto* edge_stats = reinterpret_cast<const EdgeStatRecord*>(data + header.edge_stats_offset);
+				for (size_t edge_id = 0; edge_id < header.edge_count; ++edge_id) {
+					const EdgeRecord& edge = edges[edge_id];
+					if (edge.from >= header.vertex_count || edge.to >= header.vertex_count
+						|| (edge_id > 0 && edge.from < edges[edge_id - 1].from)
+						|| !std::isfinite(edge.weight) || edge.weight < 0
+						|| edge.departure_bus > bus_count) {
+						return false;
+					}
+					const EdgeStatRecord& stat = edge_stats[edge_id];
+					const size_t object_count = stat.kind == BUS_STAT ? bus_count : header.stop_count;
+					if (stat.kind > WALK_STAT || (stat.kind != NO_STAT && stat.object_index >= object_count)) {
+						return false;
+					}
+				}
+				return true;
+			}
+
+		} // namespace
+
+		uint64_t ComputeChecksum(const TransportCatalogue& transport_catalogue, const RoutingSettings& settings) {
+			Fnv1aHasher hasher;
+			hasher.AddValue<int32_t>(settings.bus_wait_time);
+			hasher.AddValue(settings.bus_velocity);
+			hasher.AddValue<int32_t>(settings.engine);
+			hasher.AddValue<uint64_t>(settings.memory_budget);
+			hasher.AddValue<int32_t>(settings.graph_model);
+			hasher.AddValue<int32_t>(settings.vertex_order);
+			hasher.AddValue(settings.walk_radius);
+			hasher.AddValue(settings.walk_velocity);
+
+			hasher.AddValue<uint64_t>(transport_catalogue.GetAllStops().size());
+			for (const Stop& stop : transport_catalogue.GetAllStops()) {
+				hasher.AddString(stop.name);
+				hasher.AddValue(stop.coordinates.lat);
+				hasher.AddValue(stop.coordinates.lng);
+			}
+			hasher.AddValue<uint64_t>(transport_catalogue.GetAllBuses().size());
+			for (const Bus& bus : transport_catalogue.GetAllBuses()) {
+				hasher.AddString(bus.name);
+				hasher.AddValue<uint8_t>(bus.is_roundtrip);
+				hasher.AddValue<uint64_t>(bus.stops.size());
+				for (size_t i = 0; i < bus.stops.size(); ++i) {
+					hasher.AddString(bus.stops[i]->name);
+					if (i > 0) {
+						hasher.AddValue<int32_t>(transport_catalogue.GetRouteDistance(&bus, i - 1, i));
+					}
+				}
+			}
+			return hasher.Get();
+		}
+
+	} // namespace snapshot
+
+	void TransportRouter::SaveSnapshot(const std::string& path) const {
+		using namespace snapshot;
+
+		if (settings_.engine == RouterEngineType::RAPTOR) {
+			throw std::logic_error("RAPTOR engine has no graph to save");
+		}
+		// снимок должен описывать расписание без перерывов в движении
+		if (HasDisruptions()) {
+			throw std::logic_error("Cannot save snapshot while stops are closed or buses are suspended");
+		}
+
+		// номера остановок и автобусов в снимке - их Stop::id и Bus::id
+		std::vector<StopVertices> stop_vertices;
+		stop_vertices.reserve(stop_vertices_.size());
+		for (const auto& [hub, terminal] : stop_vertices_) {
+			stop_vertices.push_back({ hub, terminal });
+		}
+		std::vector<uint32_t> vertex_stops;
+		vertex_stops.reserve(vertex_stops_.size());
+		for (StopPtr stop_ptr : vertex_stops_) {
+			vertex_stops.push_back(static_cast<uint32_t>(stop_ptr->id));
+		}
+		std::vector<EdgeRecord> edges;
+		edges.reserve(graph_.GetEdgeCount());
+		for (graph::EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+			const graph::Edge<double>& edge = graph_.GetEdge(edge_id);
+			const EdgeComponents& components = edge_components_[edge_id];
+			const uint32_t departure_bus = components.departure_bus ? static_cast<uint32_t>(components.departure_bus->id) + 1 : 0;
+			edges.push_back({ edge.from, edge.to, edge.weight, components.distance, components.wait_count, departure_bus, components.departure_distance, components.walk_distance, 0 });
+		}
+		std::vector<EdgeStatRecord> edge_stats(graph_.GetEdgeCount(), EdgeStatRecord{ NO_STAT, 0, 0, 0, 0.0 });
+		for (graph::EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+			const RouteItem& item = edge_items_[edge_id];
+			EdgeStatRecord& record = edge_stats[edge_id];
+			record.time = item.time;
+			if (item.type == RouteType::WAIT) {
+				record.kind = WAIT_STAT;
+				record.object_index = static_cast<uint32_t>(vertex_stops_[graph_.GetEdge(edge_id).from]->id);
+			}
+			else if (item.type == RouteType::BUS) {
+				record.kind = BUS_STAT;
+				record.object_index = static_cast<uint32_t>(transport_catalogue_.GetBus(item.name)->id);
+				record.span_count = item.span_count;
+			}
+			else if (item.type == RouteType::WALK) {
+				record.kind = WALK_STAT;
+				record.object_index = static_cast<uint32_t>(vertex_stops_[graph_.GetEdge(edge_id).from]->id);
+			}
+		}
+
+		// таблица всех пар сохраняется только для CompactRouter: её раскладка не зависит от кучи
+		const auto* compact_router = dynamic_cast<const graph::CompactRouter<double>*>(router_.get());
+		const size_t table_vertex_count = compact_router ? graph_.GetVertexCount() : 0;
+		const size_t table_cell_count = table_vertex_count * table_vertex_count;
+
+		Header header{};
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.byte_order_mark = BYTE_ORDER_MARK;
+		header.catalogue_checksum = ComputeChecksum(transport_catalogue_, settings_);
+		header.stop_count = stop_vertices.size();
+		header.vertex_count = graph_.GetVertexCount();
+		header.edge_count = graph_.GetEdgeCount();
+		header.table_vertex_count = table_vertex_count;
+
+		size_t offset = sizeof(Header);
+		const auto place_section = [&offset](size_t size) {
+			const size_t section_offset = AlignOffset(offset);
+			offset = section_offset + size;
+			return section_offset;
+		};
+		header.stop_vertices_offset = place_section(stop_vertices.size() * sizeof(StopVertices));
+		header.vertex_stops_offset = place_section(vertex_stops.size() * sizeof(uint32_t));
+		header.edges_offset = place_section(edges.size() * sizeof(EdgeRecord));
+		header.edge_stats_offset = place_section(edge_stats.size() * sizeof(EdgeStatRecord));
+		if (compact_router) {
+			header.table_weights_offset = place_section(table_cell_count * sizeof(float));
+			header.table_prev_edges_offset = place_section(table_cell_count * sizeof(uint32_t));
+		}
+		header.file_size = offset;
+
+		// запись во временный файл и переименование: процессы, отобразившие старый снимок, его не теряют
+		const std::string temp_path = path + ".tmp"s;
+		{
+			std::ofstream output(temp_path, std::ios::binary | std::ios::trunc);
+			if (!output) {
+				throw std::runtime_error("Unable to write router snapshot: "s + temp_path);
+			}
+			size_t written = 0;
+			const auto write_section = [&output, &written](uint64_t section_offset, const void* data, size_t size) {
+				static const char padding[SECTION_ALIGNMENT] = {};
+				output.write(padding, static_cast<std::streamsize>(section_offset - written));
+				output.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+				written = section_offset + size;
+			};
+			write_section(0, &header, sizeof(header));
+			write_section(header.stop_vertices_offset, stop_vertices.data(), stop_vertices.size() * sizeof(StopVertices));
+			write_section(header.vertex_stops_offset, vertex_stops.data(), vertex_stops.size() * sizeof(uint32_t));
+			write_section(header.edges_offset, edges.data(), edges.size() * sizeof(EdgeRecord));
+			write_section(header.edge_stats_offset, edge_stats.data(), edge_stats.size() * sizeof(EdgeStatRecord));
+			if (compact_router) {
+				write_section(header.table_weights_offset, compact_router->GetTableWeights(), table_cell_count * sizeof(float));
+				write_section(header.table_prev_edges_offset, compact_router->GetTablePrevEdges(), table_cell_count * sizeof(uint32_t));
+			}
+			if (!output) {
+				throw std::runtime_error("Unable to write router snapshot: "s + temp_path);
+			}
+		}
+		std::filesystem::rename(temp_path, path);
+	}
+
+	bool TransportRouter::LoadSnapshot(const std::string& path) {
+		using namespace snapshot;
+
+		if (!std::filesystem::exists(path)) {
+			return false;
+		}
+		auto file = std::make_unique<util::MappedFile>(path);
+		const char* data = file->GetData();
+
+		Header header{};
+		if (file->GetSize() < sizeof(Header)) {
+			return false;
+		}
+		std::memcpy(&header, data, sizeof(Header));
+		const size_t stop_count = transport_catalogue_.GetAllStops().size();
+		if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION
+			|| header.byte_order_mark != BYTE_ORDER_MARK || header.file_size != file->GetSize()
+			|| header.catalogue_checksum != ComputeChecksum(transport_catalogue_, settings_)
+			|| header.stop_count != stop_count
+			|| (header.table_vertex_count != 0 && header.table_vertex_count != header.vertex_count)) {
+			return false;
+		}
+		const uint64_t table_cell_count = header.table_vertex_count * header.table_vertex_count;
+		if (!IsSectionValid<StopVertices>(header, header.stop_vertices_offset, header.stop_count)
+			|| !IsSectionValid<uint32_t>(header, header.vertex_stops_offset, header.vertex_count)
+			|| !IsSectionValid<EdgeRecord>(header, header.edges_offset, header.edge_count)
+			|| !IsSectionValid<EdgeStatRecord>(header, header.edge_stats_offset, header.edge_count)
+			|| !IsSectionValid<float>(header, header.table_weights_offset, table_cell_count)
+			|| !IsSectionValid<uint32_t>(header, header.table_prev_edges_offset, table_cell_count)) {
+			return false;
+		}
+
+		const std::deque<Stop>& stops = transport_catalogue_.GetAllStops();
+		const std::deque<Bus>& buses = transport_catalogue_.GetAllBuses();
+		// записи проверяются до заполнения членов: при отказе конструктор строит маршрутизатор заново с чистого состояния.
+		// Таблица всех пар не читается: CompactRouter проверяет её строку при первом запросе из вершины
+		if (!AreRecordsValid(header, data, buses.size())) {
+			return false;
+		}
+		const auto* stop_vertices = reinterpret_cast<const StopVertices*>(data + header.stop_vertices_offset);
+		const auto* vertex_stops = reinterpret_cast<const uint32_t*>(data + header.vertex_stops_offset);
+		const auto* edges = reinterpret_cast<const EdgeRecord*>(data + header.edges_offset);
+		const auto* edge_stats = reinterpret_cast<const EdgeStatRecord*>(data + header.edge_stats_offset);
+		const auto* table_weights = reinterpret_cast<const float*>(data + header.table_weights_offset);
+		const auto* table_prev_edges = reinterpret_cast<const uint32_t*>(data + header.table_prev_edges_offset);
+
+		stop_vertices_.reserve(stop_count);
+		for (size_t stop_index = 0; stop_index < stop_count; ++stop_index) {
+			stop_vertices_.emplace_back(stop_vertices[stop_index].hub, stop_vertices[stop_index].terminal);
+		}
+		vertex_stops_.reserve(header.vertex_count);
+		for (size_t vertex = 0; vertex < header.vertex_count; ++vertex) {
+			vertex_stops_.push_back(&stops[vertex_stops[vertex]]);
+		}
+		graph_ = graph::DirectedWeightedGraph<double>{ header.vertex_count };
+		edge_components_.reserve(header.edge_count);
+		edge_items_.assign(header.edge_count, RouteItem{});
+		for (size_t edge_id = 0; edge_id < header.edge_count; ++edge_id) {
+			const EdgeRecord& edge = edges[edge_id];
+			graph_.AddEdge({ edge.from, edge.to, edge.weight });
+			const BusPtr departure_bus = edge.departure_bus ? &buses[edge.departure_bus - 1] : nullptr;
+			edge_components_.push_back({ edge.distance, edge.wait_count, departure_bus, edge.departure_distance, edge.walk_distance });
+
+			const EdgeStatRecord& stat = edge_stats[edge_id];
+			if (stat.kind == WAIT_STAT) {
+				edge_items_[edge_id] = RouteItem::Wait(stops[stat.object_index].name, stat.time);
+			}
+			else if (stat.kind == BUS_STAT) {
+				edge_items_[edge_id] = RouteItem::Bus(buses[stat.object_index].name, stat.time, stat.span_count);
+			}
+			else if (stat.kind == WALK_STAT) {
+				edge_items_[edge_id] = RouteItem::Walk(stops[stat.object_index].name, vertex_stops_[edge.to]->name, stat.time);
+			}
+		}
+		FreezeGraph(graph_);
+		if (header.table_vertex_count == 0) {
+			BuildRouter();
+		}
+		else {
+			const Clock::time_point router_start = Clock::now();
+			router_ = std::make_unique<graph::CompactRouter<double>>(graph_,
+				table_weights, table_prev_edges, thread_pool_.get());
+			snapshot_file_ = std::move(file);
+			IndexDisruptableEdges();
+			engine_ = RouterEngineType::ALL_PAIRS_COMPACT;
+			estimated_memory_ = graph::CompactRouter<double>::EstimateMemory(header.table_vertex_count);
+			router_build_time_ = Clock::now() - router_start;
+		}
+		return true;
+	}
+
+} // namespace tc::router
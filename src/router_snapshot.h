@@ -0,0 +1,77 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tc::router::snapshot {
+
+	// Формат файла снимка маршрутизатора: заголовок и секции с фиксированной раскладкой записей,
+	// каждая секция выровнена по SECTION_ALIGNMENT от начала файла. Порядок байт - родной для машины,
+	// на которой снимок создан; при несовпадении BYTE_ORDER_MARK снимок отвергается.
+	// Таблица CompactRouter используется прямо из отображённого файла, остальное копируется в граф.
+	// Рёбра записаны в порядке замороженного графа - по вершине начала, поэтому номера рёбер
+	// в таблице совпадают с номерами после загрузки.
+
+	inline constexpr char MAGIC[8] = { 'T', 'R', 'S', 'N', 'A', 'P', '\0', '\0' };
+	inline constexpr uint32_t VERSION = 4;
+	inline constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+	inline constexpr size_t SECTION_ALIGNMENT = 64;
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order_mark;
+		uint64_t catalogue_checksum;	// справочник и настройки, по которым построен снимок
+		uint64_t stop_count;
+		uint64_t vertex_count;
+		uint64_t edge_count;
+		uint64_t table_vertex_count;	// 0 - снимок без таблицы всех пар
+		uint64_t stop_vertices_offset;	// StopVertices[stop_count] по Stop::id
+		uint64_t vertex_stops_offset;	// uint32_t[vertex_count] - Stop::id остановки вершины
+		uint64_t edges_offset;	// EdgeRecord[edge_count]
+		uint64_t edge_stats_offset;	// EdgeStatRecord[edge_count]
+		uint64_t table_weights_offset;	// float[table_vertex_count^2]
+		uint64_t table_prev_edges_offset;	// uint32_t[table_vertex_count^2]
+		uint64_t file_size;
+	};
+
+	struct StopVertices {
+		uint64_t hub;
+		uint64_t terminal;
+	};
+
+	struct EdgeRecord {
+		uint64_t from;
+		uint64_t to;
+		double weight;
+		int32_t distance;
+		int32_t wait_count;
+		uint32_t departure_bus;	// Bus::id автобуса ребра посадки + 1; 0 - не ребро посадки
+		int32_t departure_distance;
+		int32_t walk_distance;
+		uint32_t reserved;
+	};
+
+	enum EdgeStatKind : uint32_t {
+		NO_STAT,
+		WAIT_STAT,	// object_index - Stop::id
+		BUS_STAT,	// object_index - Bus::id
+		WALK_STAT	// object_index - Stop::id начала перехода, конец - остановка вершины to ребра
+	};
+
+	struct EdgeStatRecord {
+		uint32_t kind;
+		uint32_t object_index;
+		int32_t span_count;
+		uint32_t reserved;
+		double time;
+	};
+
+	// Контрольная сумма (FNV-1a) всего, от чего зависит содержимое снимка:
+	// остановок, маршрутов, расстояний между соседними остановками маршрутов и настроек построения
+	uint64_t ComputeChecksum(const TransportCatalogue& transport_catalogue, const RoutingSettings& settings);
+
+} // namespace tc::router::snapshot
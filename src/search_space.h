@@ -0,0 +1,117 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+namespace detail {
+
+// Рабочие массивы поиска по графу. Переиспользуются между запросами одного потока,
+// перед новым поиском сбрасываются только вершины, затронутые предыдущим.
+template <typename Weight>
+struct SearchSpace {
+    static constexpr Weight INFINITE_WEIGHT = std::numeric_limits<Weight>::max();
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+
+    using HeapItem = std::pair<Weight, VertexId>;
+
+    std::vector<Weight> weights;
+    std::vector<EdgeId> prev_edges;
+    std::vector<char> settled;
+    std::vector<VertexId> touched;
+    std::vector<HeapItem> heap;
+    std::vector<EdgeId> scratch_edges;  // для восстановления пути без выделения памяти на запрос
+
+    void Prepare(size_t vertex_count) {
+        for (const VertexId vertex : touched) {
+            weights[vertex] = INFINITE_WEIGHT;
+            prev_edges[vertex] = NO_EDGE;
+            settled[vertex] = 0;
+        }
+        touched.clear();
+        heap.clear();
+        if (weights.size() < vertex_count) {
+            weights.resize(vertex_count, INFINITE_WEIGHT);
+            prev_edges.resize(vertex_count, NO_EDGE);
+            settled.resize(vertex_count, 0);
+        }
+    }
+
+    // Улучшает оценку вершины и кладёт её в кучу с ключом key (по умолчанию - сама оценка);
+    // возвращает false, если оценка не улучшилась
+    bool Relax(VertexId vertex, Weight weight, EdgeId prev_edge) {
+        return Relax(vertex, weight, prev_edge, weight);
+    }
+
+    bool Relax(VertexId vertex, Weight weight, EdgeId prev_edge, Weight key) {
+        Weight& current_weight = weights[vertex];
+        if (!(weight < current_weight)) {
+            return false;
+        }
+        if (current_weight == INFINITE_WEIGHT) {
+            touched.push_back(vertex);
+        }
+        current_weight = weight;
+        prev_edges[vertex] = prev_edge;
+        PushHeap(key, vertex);
+        return true;
+    }
+
+    void PushHeap(Weight key, VertexId vertex) {
+        heap.emplace_back(key, vertex);
+        std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+    }
+
+    HeapItem PopHeap() {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+        const HeapItem item = heap.back();
+        heap.pop_back();
+        return item;
+    }
+};
+
+// Рабочие массивы текущего потока. Разные slot используются одновременно,
+// например, для прямого и обратного поиска одного запроса.
+template <typename Weight>
+SearchSpace<Weight>& GetSearchSpace(size_t vertex_count, size_t slot = 0) {
+    static thread_local std::array<SearchSpace<Weight>, 2> search_spaces;
+    SearchSpace<Weight>& search_space = search_spaces.at(slot);
+    search_space.Prepare(vertex_count);
+    return search_space;
+}
+
+// Дерево кратчайших путей из from по всему графу без отключённых рёбер: после поиска
+// все достижимые вершины - в touched и отмечены в settled. Возвращает число извлечённых вершин.
+template <typename Weight>
+size_t BuildShortestPathTree(const DirectedWeightedGraph<Weight>& graph, SearchSpace<Weight>& space, VertexId from) {
+    space.Relax(from, Weight{}, SearchSpace<Weight>::NO_EDGE);
+    size_t settled_count = 0;
+    while (!space.heap.empty()) {
+        const VertexId vertex = space.PopHeap().second;
+        if (space.settled[vertex]) {
+            continue;
+        }
+        space.settled[vertex] = 1;
+        ++settled_count;
+        const Weight weight = space.weights[vertex];
+        for (const auto& edge : graph.GetOutgoingEdges(vertex)) {
+            const EdgeId edge_id = graph.GetEdgeId(edge);
+            const Weight candidate_weight = weight + edge.weight;
+            if (graph.IsEdgeEnabled(edge_id) && candidate_weight < space.weights[edge.to]) {
+                space.Relax(edge.to, candidate_weight, edge_id);
+            }
+        }
+    }
+    return settled_count;
+}
+
+}  // namespace detail
+
+}  // namespace graph
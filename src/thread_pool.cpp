@@ -0,0 +1,90 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace util {
+
+    ThreadPool::ThreadPool(size_t thread_count) {
+        if (thread_count == 0) {
+            thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+        workers_.reserve(thread_count - 1);
+        for (size_t i = 1; i < thread_count; ++i) {
+            workers_.emplace_back([this] { WorkerLoop(); });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        task_ready_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    size_t ThreadPool::GetThreadCount() const {
+        return workers_.size() + 1;
+    }
+
+    void ThreadPool::RunTask(size_t count, std::function<void(size_t)> func) {
+        {
+            std::lock_guard lock(mutex_);
+            task_ = std::move(func);
+            task_count_ = count;
+            next_index_ = 0;
+            active_workers_ = workers_.size();
+            exception_ = nullptr;
+            ++generation_;
+        }
+        task_ready_.notify_all();
+
+        ProcessTask();
+
+        std::unique_lock lock(mutex_);
+        task_done_.wait(lock, [this] { return active_workers_ == 0; });
+        task_ = nullptr;
+        if (exception_) {
+            std::rethrow_exception(std::exchange(exception_, nullptr));
+        }
+    }
+
+    void ThreadPool::WorkerLoop() {
+        size_t seen_generation = 0;
+        while (true) {
+            {
+                std::unique_lock lock(mutex_);
+                task_ready_.wait(lock, [&] { return stopping_ || generation_ != seen_generation; });
+                if (stopping_) {
+                    return;
+                }
+                seen_generation = generation_;
+            }
+
+            ProcessTask();
+
+            std::lock_guard lock(mutex_);
+            if (--active_workers_ == 0) {
+                task_done_.notify_one();
+            }
+        }
+    }
+
+    void ThreadPool::ProcessTask() {
+        for (size_t index = next_index_++; index < task_count_; index = next_index_++) {
+            try {
+                task_(index);
+            }
+            catch (...) {
+                std::lock_guard lock(mutex_);
+                if (!exception_) {
+                    exception_ = std::current_exception();
+                }
+            }
+        }
+    }
+
+} // namespace util
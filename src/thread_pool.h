@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+    // Пул потоков для параллельной обработки независимых задач.
+    // Вызывающий поток тоже участвует в работе, поэтому пул из одного потока не создаёт новых потоков.
+    class ThreadPool {
+    public:
+        // thread_count == 0 - по числу аппаратных потоков
+        explicit ThreadPool(size_t thread_count = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        size_t GetThreadCount() const;
+
+        // Вызывает func(index) для каждого index из [0, count) и дожидается завершения всех вызовов.
+        // Первое выброшенное задачей исключение пробрасывается вызывающему.
+        // Не предназначен для одновременного вызова из нескольких потоков.
+        template <typename Func>
+        void ParallelFor(size_t count, Func&& func) {
+            if (count == 0) {
+                return;
+            }
+            if (count == 1 || workers_.empty()) {
+                for (size_t index = 0; index < count; ++index) {
+                    func(index);
+                }
+                return;
+            }
+            RunTask(count, std::function<void(size_t)>(std::forward<Func>(func)));
+        }
+
+    private:
+        void RunTask(size_t count, std::function<void(size_t)> func);
+        void WorkerLoop();
+        void ProcessTask();
+
+        std::vector<std::thread> workers_;
+        std::mutex mutex_;
+        std::condition_variable task_ready_;
+        std::condition_variable task_done_;
+
+        std::function<void(size_t)> task_;
+        size_t task_count_ = 0;
+        std::atomic<size_t> next_index_ = 0;
+        size_t active_workers_ = 0;
+        size_t generation_ = 0;
+        std::exception_ptr exception_;
+        bool stopping_ = false;
+    };
+
+} // namespace util
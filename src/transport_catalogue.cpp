@@ -1,56 +1,69 @@
 #include "transport_catalogue.h"
 
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
 namespace tc {
 
-    Stop::Stop(std::string name, geo::Coordinates coordinates) : name(std::move(name)), coordinates(std::move(coordinates)) {
+    Stop::Stop(std::string name, geo::Coordinates coordinates, size_t id) : name(std::move(name)), coordinates(std::move(coordinates)), id(id) {
     }
 
-    Bus::Bus(std::string name, std::vector<StopPtr> stops, StopPtr end_stop_ptr, bool is_roundtrip) :
+    Bus::Bus(std::string name, std::vector<StopPtr> stops, StopPtr end_stop_ptr, bool is_roundtrip, size_t id) :
         name(std::move(name)),
         stops(std::move(stops)),
         end_stop_ptr(end_stop_ptr),
-        is_roundtrip(is_roundtrip) {
-    }
-
-    double GetStrightRouteLength(BusPtr bus_ptr) {
-        double distance = 0.0;
-        auto& stops = bus_ptr->stops;
-        if (stops.size() < 2) {
-            return 0.0;
-        }
-        auto pos = stops.begin();
-        auto prev_pos = stops.begin();
-        while (++pos != stops.end()) {
-            distance += ComputeDistance((*(pos - 1))->coordinates, (*pos)->coordinates);
-            prev_pos = pos;
-        }
-        return distance;
+        is_roundtrip(is_roundtrip),
+        id(id) {
     }
 
     void TransportCatalogue::AddStop(const std::string& name, const geo::Coordinates coordinates) {
-        Stop& stop = stops_.emplace_back(name, coordinates);
+        Stop& stop = stops_.emplace_back(name, coordinates, stops_.size());
         stopname_to_stop_[stop.name] = &stop;
-        stop_to_buses_[&stop] = {};
+        stop_to_buses_.emplace_back();
+        distances_.emplace_back();
     }
 
-    void TransportCatalogue::AddBus(const std::string& name, const std::vector<StopPtr>& stops, StopPtr end_stop_ptr, bool is_roundtrip) {
-        Bus& bus = buses_.emplace_back(name, stops, end_stop_ptr, is_roundtrip);
+    void TransportCatalogue::AddBus(const std::string& name, const std::vector<StopPtr>& stops, StopPtr end_stop_ptr, bool is_roundtrip, BusSchedule schedule) {
+        is_finalized_.store(false, std::memory_order_relaxed);
+        Bus& bus = buses_.emplace_back(name, stops, end_stop_ptr, is_roundtrip, buses_.size());
+        bus.schedule = std::move(schedule);
         busname_to_bus_[bus.name] = &bus;
         for (StopPtr stop : bus.stops) {
-            stop_to_buses_.at(stop).insert(&bus);
+            stop_to_buses_.at(stop->id).insert(&bus);
         }
     }
 
     void TransportCatalogue::SetDistance(StopPtr stop_from_ptr, StopPtr stop_to_ptr, int distance) {
-        distances_[{stop_from_ptr, stop_to_ptr}] = distance;
+        is_finalized_.store(false, std::memory_order_relaxed);
+        std::vector<std::pair<size_t, int>>& stop_distances = distances_.at(stop_from_ptr->id);
+        for (auto& [stop_id, stop_distance] : stop_distances) {
+            if (stop_id == stop_to_ptr->id) {
+                stop_distance = distance;
+                return;
+            }
+        }
+        stop_distances.emplace_back(stop_to_ptr->id, distance);
+    }
+
+    std::optional<int> TransportCatalogue::FindDistance(StopPtr stop_from_ptr, StopPtr stop_to_ptr) const {
+        for (const auto& [stop_id, distance] : distances_.at(stop_from_ptr->id)) {
+            if (stop_id == stop_to_ptr->id) {
+                return distance;
+            }
+        }
+        return std::nullopt;
     }
 
     int TransportCatalogue::GetDistance(StopPtr stop_from_ptr, StopPtr stop_to_ptr) const {
-        auto it = distances_.find(std::make_pair(stop_from_ptr, stop_to_ptr));
-        if (it == distances_.end()) {
-            it = distances_.find(std::make_pair(stop_to_ptr, stop_from_ptr));
+        // расстояние в обратную сторону используется, если в прямую не задано
+        if (std::optional<int> distance = FindDistance(stop_from_ptr, stop_to_ptr)) {
+            return *distance;
+        }
+        if (std::optional<int> distance = FindDistance(stop_to_ptr, stop_from_ptr)) {
+            return *distance;
         }
-        return it->second;
+        throw std::out_of_range("Distance between stops is not set: " + stop_from_ptr->name + " - " + stop_to_ptr->name);
     }
 
     const std::deque<Stop>& TransportCatalogue::GetAllStops() const {
@@ -75,34 +88,100 @@ namespace tc {
         return busname_to_bus_.at(name);
     }
     const std::unordered_set<BusPtr>& TransportCatalogue::GetBusesAtStop(StopPtr stop_ptr) const {
-        return stop_to_buses_.at(stop_ptr);
+        return stop_to_buses_.at(stop_ptr->id);
     }
 
-    RouteInfo TransportCatalogue::GetRouteInfo(BusPtr bus_ptr) const {
-        RouteInfo info{};
-        double stright_distance = 0.0;
+    void TransportCatalogue::Finalize() {
+        EnsureFinalized();
+    }
+
+    void TransportCatalogue::EnsureFinalized() const {
+        // маршрутизатор запрашивает расстояния из нескольких потоков: предрасчёт выполняет первый из них
+        if (is_finalized_.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::lock_guard lock{ finalize_mutex_ };
+        if (is_finalized_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        bus_routes_.clear();
+        bus_routes_.reserve(buses_.size());
+        for (const Bus& bus : buses_) {
+            bus_routes_.push_back(ComputeBusRoute(bus));
+        }
+        is_finalized_.store(true, std::memory_order_release);
+    }
 
-        auto& stops = bus_ptr->stops;
+    TransportCatalogue::BusRoute TransportCatalogue::ComputeBusRoute(const Bus& bus) const {
+        BusRoute route;
+        RouteInfo& info = route.info;
+        const auto& stops = bus.stops;
         info.stops_count = stops.size();
         info.unique_stops_count = info.stops_count;
+        route.distances.assign(stops.size(), 0);
+        route.geo_distances.assign(stops.size(), 0.0);
         if (stops.size() < 2) {
-            return info;
+            return route;
         }
 
-        auto pos = stops.begin();
-        auto prev_pos = stops.begin();
-        std::unordered_set<StopPtr> unique_stops;
-        unique_stops.insert(*pos);
-        while (++pos != stops.end()) {
-            unique_stops.insert(*pos);
-            info.distance += GetDistance(*prev_pos, *pos);
-            stright_distance += geo::ComputeDistance((*prev_pos)->coordinates, (*pos)->coordinates);
-            prev_pos = pos;
+        std::vector<size_t> stop_ids{ stops.front()->id };
+        try {
+            for (size_t i = 1; i < stops.size(); ++i) {
+                stop_ids.push_back(stops[i]->id);
+                route.distances[i] = route.distances[i - 1] + GetDistance(stops[i - 1], stops[i]);
+                route.geo_distances[i] = route.geo_distances[i - 1] + geo::ComputeDistance(stops[i - 1]->coordinates, stops[i]->coordinates);
+            }
+        }
+        catch (const std::out_of_range& error) {
+            // ошибка относится только к этому автобусу и выдаётся при запросе его маршрута
+            route.error = error.what();
+            return route;
         }
 
-        info.unique_stops_count = unique_stops.size();
-        info.curvature = info.distance / stright_distance;
+        std::sort(stop_ids.begin(), stop_ids.end());
+        info.unique_stops_count = std::unique(stop_ids.begin(), stop_ids.end()) - stop_ids.begin();
+        info.distance = route.distances.back();
+        info.curvature = info.distance / route.geo_distances.back();
+        return route;
+    }
+
+    const TransportCatalogue::BusRoute& TransportCatalogue::GetBusRoute(BusPtr bus_ptr) const {
+        EnsureFinalized();
+        const BusRoute& route = bus_routes_.at(bus_ptr->id);
+        if (!route.error.empty()) {
+            throw std::out_of_range(route.error);
+        }
+        return route;
+    }
+
+    RouteInfo TransportCatalogue::GetRouteInfo(BusPtr bus_ptr) const {
+        return GetBusRoute(bus_ptr).info;
+    }
 
-        return info;
+    const std::vector<int>& TransportCatalogue::GetRouteDistances(BusPtr bus_ptr) const {
+        return GetBusRoute(bus_ptr).distances;
+    }
+
+    int TransportCatalogue::GetRouteDistance(BusPtr bus_ptr, size_t from_index, size_t to_index) const {
+        const std::vector<int>& distances = GetBusRoute(bus_ptr).distances;
+        return distances.at(to_index) - distances.at(from_index);
+    }
+
+    double TransportCatalogue::GetRouteGeoDistance(BusPtr bus_ptr, size_t from_index, size_t to_index) const {
+        const std::vector<double>& geo_distances = GetBusRoute(bus_ptr).geo_distances;
+        return geo_distances.at(to_index) - geo_distances.at(from_index);
+    }
+
+    std::vector<NearbyStops> TransportCatalogue::FindNearbyStops(double radius) const {
+        std::vector<geo::Coordinates> coordinates;
+        coordinates.reserve(stops_.size());
+        for (const Stop& stop : stops_) {
+            coordinates.push_back(stop.coordinates);
+        }
+        std::vector<NearbyStops> nearby_stops;
+        for (const geo::NearbyPair& pair : geo::FindNearbyPairs(coordinates, radius)) {
+            nearby_stops.push_back(NearbyStops{ &stops_[pair.first], &stops_[pair.second], static_cast<int>(std::ceil(pair.distance)) });
+        }
+        return nearby_stops;
     }
 }
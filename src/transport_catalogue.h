@@ -1,11 +1,14 @@
 #pragma once
 
+#include <atomic>
 #include <deque>
 #include <iterator>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "domain.h"
@@ -13,16 +16,17 @@
 
 namespace tc {
 
-	struct StopPointersHasher {
-		size_t operator()(const std::pair<StopPtr, StopPtr>& stop_pair) const {
-			return (size_t)(stop_pair.first) + ((size_t)(stop_pair.second) * 5);
-		}
+	// Две разные остановки недалеко друг от друга; distance - расстояние по прямой в метрах, округлённое вверх
+	struct NearbyStops {
+		StopPtr first;
+		StopPtr second;
+		int distance;
 	};
 
 	class TransportCatalogue {
 	public:
 		void AddStop(const std::string& name, const geo::Coordinates coordinates);
-		void AddBus(const std::string& name, const std::vector<StopPtr>& stops, StopPtr end_stop_ptr, bool is_roundtrip);
+		void AddBus(const std::string& name, const std::vector<StopPtr>& stops, StopPtr end_stop_ptr, bool is_roundtrip, BusSchedule schedule = {});
 		void SetDistance(StopPtr stop_from_ptr, const StopPtr stop_to_ptr, int distance);
 		int GetDistance(StopPtr stop_from_ptr, StopPtr stop_to_ptr) const;
 		const std::deque<Stop>& GetAllStops() const;
@@ -30,15 +34,45 @@ namespace tc {
 		StopPtr GetStop(const std::string_view name) const;
 		BusPtr GetBus(const std::string_view name) const;
 		const std::unordered_set<BusPtr>& GetBusesAtStop(StopPtr stop_ptr) const;
+		// Предрасчёт маршрутов автобусов: накопленные расстояния по дорогам и по прямой и RouteInfo.
+		// Выполняется при первом запросе ниже после AddBus или SetDistance; Finalize делает это заранее.
+		// Добавлять маршруты и расстояния одновременно с запросами нельзя.
+		void Finalize();
 		RouteInfo GetRouteInfo(const BusPtr) const;
+		// Расстояния по дорогам от первой остановки маршрута до i-й остановки bus.stops
+		const std::vector<int>& GetRouteDistances(BusPtr bus_ptr) const;
+		// Расстояние по дорогам и по прямой между from_index-й и to_index-й остановками bus.stops, from_index <= to_index
+		int GetRouteDistance(BusPtr bus_ptr, size_t from_index, size_t to_index) const;
+		double GetRouteGeoDistance(BusPtr bus_ptr, size_t from_index, size_t to_index) const;
+		// Пары остановок не дальше radius метров друг от друга по прямой, каждая пара один раз, first->id < second->id
+		std::vector<NearbyStops> FindNearbyStops(double radius) const;
 
 	private:
+		struct BusRoute {
+			std::vector<int> distances;	// по дорогам от первой остановки до i-й
+			std::vector<double> geo_distances;	// по прямой через все остановки от первой до i-й
+			RouteInfo info;
+			std::string error;	// непусто, если между соседними остановками не задано расстояние
+		};
+
+		std::optional<int> FindDistance(StopPtr stop_from_ptr, StopPtr stop_to_ptr) const;
+		void EnsureFinalized() const;
+		BusRoute ComputeBusRoute(const Bus& bus) const;
+		const BusRoute& GetBusRoute(BusPtr bus_ptr) const;
+
 		std::deque<Stop> stops_;
 		std::unordered_map<std::string_view, StopPtr> stopname_to_stop_;
 		std::deque<Bus> buses_;
 		std::unordered_map<std::string_view, BusPtr> busname_to_bus_;
-		std::unordered_map<StopPtr, std::unordered_set<BusPtr>> stop_to_buses_;
-		std::unordered_map<std::pair<StopPtr, StopPtr>, int, StopPointersHasher> distances_;
+		// внутренние массивы индексируются Stop::id
+		std::vector<std::unordered_set<BusPtr>> stop_to_buses_;
+		// расстояния от остановки до соседних: пары (id остановки назначения, метры); соседей немного,
+		// поэтому поиск перебором быстрее хеширования пары указателей
+		std::vector<std::vector<std::pair<size_t, int>>> distances_;
+		// по Bus::id; строятся при первом запросе после изменения справочника
+		mutable std::vector<BusRoute> bus_routes_;
+		mutable std::atomic<bool> is_finalized_ = false;
+		mutable std::mutex finalize_mutex_;
 	};
 
 } // namespace tc
\ No newline at end of file
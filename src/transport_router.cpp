@@ -1,39 +1,397 @@
 #include "graph.h"
+#include "raptor_router.h"
 #include "router.h"
+#include "thread_pool.h"
 #include "transport_router.h"
+#include "vertex_order.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <stdexcept>
+#include <utility>
 
 namespace tc::router {
 
+	TransportRouter::TransportRouter(const TransportCatalogue& transport_catalogue, RoutingSettings settings) :
+		transport_catalogue_(transport_catalogue),
+		settings_(std::move(settings)),
+		thread_pool_(std::make_unique<util::ThreadPool>()),
+		closed_stops_(transport_catalogue.GetAllStops().size(), 0),
+		suspended_buses_(transport_catalogue.GetAllBuses().size(), 0),
+		route_cache_(settings_.route_cache_capacity) {
+		const bool uses_snapshot = settings_.engine != RouterEngineType::RAPTOR && !settings_.snapshot_path.empty();
+		if (uses_snapshot) {
+			const Clock::time_point graph_start = Clock::now();
+			if (LoadSnapshot(settings_.snapshot_path)) {
+				graph_build_time_ = Clock::now() - graph_start - router_build_time_;
+				snapshot_loaded_ = true;
+				return;
+			}
+		}
+		if (settings_.engine != RouterEngineType::RAPTOR) {
+			const Clock::time_point graph_start = Clock::now();
+			graph_ = ConstructGraph();
+			graph_build_time_ = Clock::now() - graph_start;
+		}
+		BuildRouter();
+		if (uses_snapshot) {
+			SaveSnapshot(settings_.snapshot_path);
+		}
+	}
+
+	TransportRouter::~TransportRouter() = default;
+
+	void TransportRouter::BuildRouter() {
+		const Clock::time_point router_start = Clock::now();
+		router_.reset();
+		raptor_router_.reset();
+		snapshot_file_.reset();
+		engine_ = ChooseEngine();
+		estimated_memory_ = EstimateRouterMemory(engine_);
+		if (engine_ == RouterEngineType::RAPTOR) {
+			// RAPTOR работает по маршрутам справочника, граф ему не нужен
+			raptor_router_ = std::make_unique<RaptorRouter>(transport_catalogue_, settings_);
+			raptor_router_->SetDisruptions(closed_stops_, suspended_buses_);
+			stop_edges_.assign(transport_catalogue_.GetAllStops().size(), {});
+			bus_edges_.assign(transport_catalogue_.GetAllBuses().size(), {});
+		}
+		else {
+			// встречному поиску нужны входящие рёбра
+			if (engine_ == RouterEngineType::BIDIRECTIONAL_DIJKSTRA && !graph_.HasReverseIndex()) {
+				graph_.BuildReverseIndex();
+			}
+			// предрасчёт строится сразу по графу с отключёнными рёбрами
+			IndexDisruptableEdges();
+			MaskDisruptedEdges();
+			router_ = MakeRouter();
+		}
+		router_build_time_ = Clock::now() - router_start;
+	}
+
+	size_t TransportRouter::EstimateRouterMemory(RouterEngineType engine) const {
+		const size_t vertex_count = graph_.GetVertexCount();
+		const size_t edge_count = graph_.GetEdgeCount();
+		switch (engine) {
+		case RouterEngineType::ALL_PAIRS:
+			return graph::Router<double>::EstimateMemory(vertex_count);
+		case RouterEngineType::ALL_PAIRS_COMPACT:
+			return graph::CompactRouter<double>::EstimateMemory(vertex_count);
+		case RouterEngineType::ALL_PAIRS_FIXED:
+			return graph::CompactRouter<double, uint32_t>::EstimateMemory(vertex_count);
+		case RouterEngineType::DIJKSTRA:
+		case RouterEngineType::A_STAR:
+			return graph::DijkstraRouter<double>::EstimateMemory(vertex_count);
+		case RouterEngineType::BIDIRECTIONAL_DIJKSTRA:
+			return graph::BidirectionalDijkstraRouter<double>::EstimateMemory(vertex_count, edge_count);
+		case RouterEngineType::CONTRACTION_HIERARCHY:
+			return graph::ContractionHierarchy<double>::EstimateMemory(vertex_count, edge_count);
+		default:
+			// RAPTOR не строит граф, его массивы линейны по размеру справочника и не оцениваются
+			return 0;
+		}
+	}
+
+	RouterEngineType TransportRouter::ChooseEngine() const {
+		if (settings_.engine == RouterEngineType::RAPTOR || (settings_.engine != RouterEngineType::AUTO && settings_.memory_budget == 0)) {
+			return settings_.engine;
+		}
+		// таблица всех пар растёт как квадрат числа вершин графа, иерархия и поиск по запросу - линейно
+		const size_t memory_budget = settings_.memory_budget != 0 ? settings_.memory_budget : DEFAULT_MEMORY_BUDGET;
+		if (settings_.engine != RouterEngineType::AUTO && EstimateRouterMemory(settings_.engine) <= memory_budget) {
+			return settings_.engine;
+		}
+		// движки по убыванию скорости запросов. Остальные не могут выиграть: ALL_PAIRS_FIXED оценивается
+		// как COMPACT, ALL_PAIRS - больше него, DIJKSTRA - как A*, но медленнее
+		constexpr RouterEngineType candidates[] = {
+			RouterEngineType::ALL_PAIRS_COMPACT, RouterEngineType::CONTRACTION_HIERARCHY,
+			RouterEngineType::BIDIRECTIONAL_DIJKSTRA, RouterEngineType::A_STAR
+		};
+		for (const RouterEngineType engine : candidates) {
+			if (EstimateRouterMemory(engine) <= memory_budget) {
+				return engine;
+			}
+		}
+		// у A* наименьшая оценка из движков графа - только рабочие массивы поиска по вершинам,
+		// без рёбер, как у встречного поиска и иерархии, - поэтому без подходящего движка берётся он
+		return RouterEngineType::A_STAR;
+	}
+
+	void TransportRouter::ApplySettings(RoutingSettings settings) {
+		const RoutingSettings old_settings = std::exchange(settings_, std::move(settings));
+		route_cache_.Reset(settings_.route_cache_capacity);
+		snapshot_loaded_ = false;
+
+		const bool had_graph = old_settings.engine != RouterEngineType::RAPTOR;
+		const bool needs_graph = settings_.engine != RouterEngineType::RAPTOR;
+		const bool weights_changed = old_settings.bus_wait_time != settings_.bus_wait_time || old_settings.bus_velocity != settings_.bus_velocity
+			|| old_settings.walk_velocity != settings_.walk_velocity;
+		// пешие переходы - отдельные рёбры графа, при смене радиуса их набор другой
+		const bool walks_changed = old_settings.walk_radius != settings_.walk_radius;
+		const bool order_changed = old_settings.vertex_order != settings_.vertex_order;
+
+		if (needs_graph) {
+			const Clock::time_point graph_start = Clock::now();
+			if (!had_graph || old_settings.graph_model != settings_.graph_model || walks_changed || order_changed) {
+				router_.reset();
+				stop_vertices_.clear();
+				edge_items_.clear();
+				vertex_stops_.clear();
+				edge_components_.clear();
+				graph_ = ConstructGraph();
+			}
+			else {
+				if (weights_changed) {
+					ReweightGraph();
+				}
+				if (!weights_changed && old_settings.engine == settings_.engine && old_settings.memory_budget == settings_.memory_budget) {
+					// граф и предрасчёт остались прежними
+					return;
+				}
+			}
+			graph_build_time_ = Clock::now() - graph_start;
+		}
+		else if (had_graph) {
+			router_.reset();
+			graph_ = {};
+			stop_vertices_.clear();
+			edge_items_.clear();
+			vertex_stops_.clear();
+			edge_components_.clear();
+		}
+		else if (!weights_changed && !walks_changed) {
+			return;
+		}
+		BuildRouter();
+	}
+
+	void TransportRouter::SetStopClosed(StopPtr stop, bool is_closed) {
+		char& is_stop_closed = closed_stops_.at(stop->id);
+		if (static_cast<bool>(is_stop_closed) != is_closed) {
+			is_stop_closed = is_closed;
+			ApplyDisruptions(stop_edges_[stop->id]);
+		}
+	}
+
+	void TransportRouter::SetBusSuspended(BusPtr bus, bool is_suspended) {
+		char& is_bus_suspended = suspended_buses_.at(bus->id);
+		if (static_cast<bool>(is_bus_suspended) != is_suspended) {
+			is_bus_suspended = is_suspended;
+			ApplyDisruptions(bus_edges_[bus->id]);
+		}
+	}
+
+	bool TransportRouter::IsStopClosed(StopPtr stop) const {
+		return closed_stops_.at(stop->id);
+	}
+
+	bool TransportRouter::IsBusSuspended(BusPtr bus) const {
+		return suspended_buses_.at(bus->id);
+	}
+
+	bool TransportRouter::HasDisruptions() const {
+		const auto is_set = [](char value) {
+			return value != 0;
+		};
+		return std::any_of(closed_stops_.begin(), closed_stops_.end(), is_set)
+			|| std::any_of(suspended_buses_.begin(), suspended_buses_.end(), is_set);
+	}
+
+	bool TransportRouter::IsClosedStopVertex(graph::VertexId vertex) const {
+		// вершины поездок закрытой остановки остаются: автобус проезжает её без остановки
+		StopPtr stop = vertex_stops_[vertex];
+		if (!closed_stops_[stop->id]) {
+			return false;
+		}
+		const auto [hub_vertex, terminal_vertex] = stop_vertices_[stop->id];
+		return vertex == hub_vertex || vertex == terminal_vertex;
+	}
+
+	bool TransportRouter::IsEdgeDisrupted(graph::EdgeId edge_id) const {
+		// ребро может быть отключено сразу по нескольким причинам, поэтому проверяются все
+		const graph::Edge<double>& edge = graph_.GetEdge(edge_id);
+		const BusPtr bus = edge_components_[edge_id].departure_bus;
+		return (bus != nullptr && suspended_buses_[bus->id]) || IsClosedStopVertex(edge.from) || IsClosedStopVertex(edge.to);
+	}
+
+	void TransportRouter::IndexDisruptableEdges() {
+		stop_edges_.assign(transport_catalogue_.GetAllStops().size(), {});
+		bus_edges_.assign(transport_catalogue_.GetAllBuses().size(), {});
+		const auto is_stop_vertex = [this](graph::VertexId vertex) {
+			const auto [hub_vertex, terminal_vertex] = stop_vertices_[vertex_stops_[vertex]->id];
+			return vertex == hub_vertex || vertex == terminal_vertex;
+		};
+		for (graph::EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+			const graph::Edge<double>& edge = graph_.GetEdge(edge_id);
+			StopPtr from_stop = vertex_stops_[edge.from];
+			StopPtr to_stop = vertex_stops_[edge.to];
+			if (is_stop_vertex(edge.from)) {
+				stop_edges_[from_stop->id].push_back(edge_id);
+			}
+			// ожидание на остановке соединяет две её вершины и записывается один раз
+			if (is_stop_vertex(edge.to) && !(to_stop == from_stop && is_stop_vertex(edge.from))) {
+				stop_edges_[to_stop->id].push_back(edge_id);
+			}
+			if (const BusPtr bus = edge_components_[edge_id].departure_bus) {
+				bus_edges_[bus->id].push_back(edge_id);
+			}
+		}
+	}
+
+	std::vector<graph::EdgeId> TransportRouter::MaskDisruptedEdges() {
+		std::vector<graph::EdgeId> changed_edges;
+		for (graph::EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+			const bool is_disrupted = IsEdgeDisrupted(edge_id);
+			if (graph_.IsEdgeEnabled(edge_id) == is_disrupted) {
+				graph_.SetEdgeEnabled(edge_id, !is_disrupted);
+				changed_edges.push_back(edge_id);
+			}
+		}
+		return changed_edges;
+	}
+
+	std::vector<graph::EdgeId> TransportRouter::MaskDisruptedEdges(const std::vector<graph::EdgeId>& edge_ids) {
+		std::vector<graph::EdgeId> changed_edges;
+		for (const graph::EdgeId edge_id : edge_ids) {
+			const bool is_disrupted = IsEdgeDisrupted(edge_id);
+			if (graph_.IsEdgeEnabled(edge_id) == is_disrupted) {
+				graph_.SetEdgeEnabled(edge_id, !is_disrupted);
+				changed_edges.push_back(edge_id);
+			}
+		}
+		return changed_edges;
+	}
+
+	void TransportRouter::ApplyDisruptions(const std::vector<graph::EdgeId>& edge_ids) {
+		const Clock::time_point update_start = Clock::now();
+		route_cache_.Reset(settings_.route_cache_capacity);
+		if (raptor_router_) {
+			raptor_router_->SetDisruptions(closed_stops_, suspended_buses_);
+		}
+		else {
+			// меняется маска только рёбер переключённой остановки или автобуса
+			router_->UpdateEdges(MaskDisruptedEdges(edge_ids));
+		}
+		disruption_update_time_ = Clock::now() - update_start;
+	}
+
+	void TransportRouter::ReweightGraph() {
+		for (graph::EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+			graph_.SetEdgeWeight(edge_id, GetEdgeWeight(edge_components_[edge_id]));
+		}
+		for (graph::EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+			edge_items_[edge_id].time = graph_.GetEdge(edge_id).weight;
+		}
+	}
+
 	void TransportRouter::AddStopsToGraph(graph::DirectedWeightedGraph<double>& graph) {
 		size_t vertex_counter = 0;
 		for (const Stop& stop : transport_catalogue_.GetAllStops()) {
 			StopPtr stop_ptr = &stop;
 			size_t hub_vertex_id = vertex_counter++;
 			size_t terminal_vertex_id = vertex_counter++;
-			stop_vertices_[stop_ptr] = std::make_pair(hub_vertex_id, terminal_vertex_id);
-			size_t edge_id = graph.AddEdge({ hub_vertex_id, terminal_vertex_id, static_cast<double>(settings_.bus_wait_time) });
-			edge_stats_[edge_id] = std::make_shared<WaitRouteStat>(stop_ptr->name, static_cast<double>(settings_.bus_wait_time));
+			stop_vertices_.emplace_back(hub_vertex_id, terminal_vertex_id);
+			vertex_stops_.push_back(stop_ptr);
+			vertex_stops_.push_back(stop_ptr);
+			size_t edge_id = AddEdge(graph, hub_vertex_id, terminal_vertex_id, { 0, 1 });
+			edge_items_[edge_id] = RouteItem::Wait(stop_ptr->name, graph.GetEdge(edge_id).weight);
+		}
+	}
+
+	void TransportRouter::AddBusEdges(EdgeBlock& block, const Bus& bus) const {
+		const std::vector<int>& distance_offsets = transport_catalogue_.GetRouteDistances(&bus);
+		if (bus.is_roundtrip) {
+			SetBusEdges(block, bus, distance_offsets, bus.stops.cbegin(), bus.stops.cend());
+		}
+		else {
+			size_t end_stop_index = bus.stops.size() / 2;
+			auto end_stop_ptr_it = bus.stops.cbegin() + end_stop_index;
+			SetBusEdges(block, bus, distance_offsets, bus.stops.cbegin(), end_stop_ptr_it + 1);
+			SetBusEdges(block, bus, distance_offsets, end_stop_ptr_it, bus.stops.cend());
 		}
 	}
 
 	void TransportRouter::AddBussesToGraph(graph::DirectedWeightedGraph<double>& graph) {
-		for (const Bus& bus : transport_catalogue_.GetAllBuses()) {
-			if (bus.is_roundtrip) {
-				SetRouteEdges(graph, bus.name, bus.stops.cbegin(), bus.stops.cend());
+		const std::deque<Bus>& buses = transport_catalogue_.GetAllBuses();
+		util::ThreadPool& pool = *thread_pool_;
+		// по несколько отрезков автобусов на поток, чтобы длинные маршруты не задерживали остальные потоки
+		const size_t block_count = std::min(buses.size(), pool.GetThreadCount() * 4);
+		const auto get_first_bus = [&](size_t block_index) {
+			return block_index * buses.size() / block_count;
+		};
+
+		std::vector<EdgeBlock> blocks(block_count);
+		size_t ride_vertex = vertex_stops_.size();
+		for (size_t block_index = 0; block_index < block_count; ++block_index) {
+			blocks[block_index].first_ride_vertex = ride_vertex;
+			for (size_t bus_index = get_first_bus(block_index); bus_index < get_first_bus(block_index + 1); ++bus_index) {
+				ride_vertex += CountRideVertices(buses[bus_index]);
 			}
-			else {
-				size_t end_stop_index = bus.stops.size() / 2;
-				auto end_stop_ptr_it = bus.stops.cbegin() + end_stop_index;
-				SetRouteEdges(graph, bus.name, bus.stops.cbegin(), end_stop_ptr_it + 1);
-				SetRouteEdges(graph, bus.name, end_stop_ptr_it, bus.stops.cend());
+		}
+		pool.ParallelFor(block_count, [&](size_t block_index) {
+			for (size_t bus_index = get_first_bus(block_index); bus_index < get_first_bus(block_index + 1); ++bus_index) {
+				AddBusEdges(blocks[block_index], buses[bus_index]);
+			}
+		});
+
+		// блоки занимают подряд идущие диапазоны номеров рёбер в порядке автобусов - как при последовательном построении
+		std::vector<size_t> first_edges(block_count + 1, edge_components_.size());
+		for (size_t block_index = 0; block_index < block_count; ++block_index) {
+			first_edges[block_index + 1] = first_edges[block_index] + blocks[block_index].edges.size();
+		}
+		edge_components_.resize(first_edges.back());
+		edge_items_.resize(first_edges.back());
+		vertex_stops_.resize(ride_vertex);
+		pool.ParallelFor(block_count, [&](size_t block_index) {
+			const EdgeBlock& block = blocks[block_index];
+			std::copy(block.components.begin(), block.components.end(), edge_components_.begin() + first_edges[block_index]);
+			std::copy(block.items.begin(), block.items.end(), edge_items_.begin() + first_edges[block_index]);
+			std::copy(block.ride_vertex_stops.begin(), block.ride_vertex_stops.end(), vertex_stops_.begin() + block.first_ride_vertex);
+		});
+		graph.ReserveEdges(first_edges.back());
+		for (const EdgeBlock& block : blocks) {
+			for (const graph::Edge<double>& edge : block.edges) {
+				graph.AddEdge(edge);
 			}
 		}
 	}
 
+	void TransportRouter::AddWalksToGraph(graph::DirectedWeightedGraph<double>& graph) {
+		if (settings_.walk_radius <= 0.0) {
+			return;
+		}
+		// переход ведёт в hub соседней остановки: после него, как и после поездки, нужно ожидание для посадки
+		for (const NearbyStops& nearby_stops : transport_catalogue_.FindNearbyStops(settings_.walk_radius)) {
+			for (const auto& [stop_from, stop_to] : { std::pair{ nearby_stops.first, nearby_stops.second }, std::pair{ nearby_stops.second, nearby_stops.first } }) {
+				EdgeComponents components;
+				components.walk_distance = nearby_stops.distance;
+				size_t edge_id = AddEdge(graph, stop_vertices_[stop_from->id].first, stop_vertices_[stop_to->id].first, components);
+				edge_items_[edge_id] = RouteItem::Walk(stop_from->name, stop_to->name, graph.GetEdge(edge_id).weight);
+			}
+		}
+	}
+
+	size_t TransportRouter::CountVertices() const {
+		size_t vertex_count = transport_catalogue_.GetAllStops().size() * 2;
+		for (const Bus& bus : transport_catalogue_.GetAllBuses()) {
+			vertex_count += CountRideVertices(bus);
+		}
+		return vertex_count;
+	}
+
+	size_t TransportRouter::CountRideVertices(const Bus& bus) const {
+		if (settings_.graph_model != GraphModelType::RIDE_CHAINS) {
+			return 0;
+		}
+		// у некольцевого маршрута конечная остановка входит в обе половины
+		return bus.is_roundtrip ? bus.stops.size() : bus.stops.size() + 1;
+	}
+
 	graph::DirectedWeightedGraph<double> TransportRouter::ConstructGraph() {
-		graph::DirectedWeightedGraph<double> graph{ transport_catalogue_.GetAllStops().size() * 2 };
+		graph::DirectedWeightedGraph<double> graph{ CountVertices() };
 
 		// добавляем в граф остановки - на каждую два узла и грань ожидания
 		AddStopsToGraph(graph);
@@ -41,25 +399,430 @@ namespace tc::router {
 		// добавляем маршруты, каждая остановка - грани ко всем следующим остановкам до конечной (и обратно, для не кольцевых маршрутов)
 		AddBussesToGraph(graph);
 
+		// пешие переходы между близкими остановками, если они включены
+		AddWalksToGraph(graph);
+
+		FreezeGraph(graph);
+
+		// перенумерация вершин для локальности в памяти, если она задана
+		ReorderVertices(graph);
 		return graph;
 	}
 
+	void TransportRouter::FreezeGraph(graph::DirectedWeightedGraph<double>& graph) {
+		// заморозка упорядочивает рёбра по вершине начала; массивы по номерам рёбер переставляются вслед за ними
+		PermuteEdges(graph.Freeze());
+	}
+
+	void TransportRouter::ReorderVertices(graph::DirectedWeightedGraph<double>& graph) {
+		std::vector<graph::VertexId> new_vertex_ids;
+		switch (settings_.vertex_order) {
+		case VertexOrderType::CUTHILL_MCKEE:
+			new_vertex_ids = graph::ComputeCuthillMcKeeOrder(graph);
+			break;
+		case VertexOrderType::HILBERT:
+			new_vertex_ids = ComputeHilbertVertexIds();
+			break;
+		default:
+			return;
+		}
+
+		PermuteEdges(graph.RenumberVertices(new_vertex_ids));
+		// stop_vertices_ и vertex_stops_ - соответствие вершин остановкам - переводятся в новые номера
+		for (auto& [hub, terminal] : stop_vertices_) {
+			hub = new_vertex_ids[hub];
+			terminal = new_vertex_ids[terminal];
+		}
+		std::vector<StopPtr> vertex_stops(vertex_stops_.size());
+		for (graph::VertexId vertex = 0; vertex < vertex_stops_.size(); ++vertex) {
+			vertex_stops[new_vertex_ids[vertex]] = vertex_stops_[vertex];
+		}
+		vertex_stops_ = std::move(vertex_stops);
+	}
+
+	std::vector<graph::VertexId> TransportRouter::ComputeHilbertVertexIds() const {
+		// остановки по кривой Гильберта, вершины остановки (hub, terminal и вершины поездок через неё)
+		// идут подряд в прежнем порядке
+		std::vector<geo::Coordinates> coordinates;
+		coordinates.reserve(transport_catalogue_.GetAllStops().size());
+		for (const Stop& stop : transport_catalogue_.GetAllStops()) {
+			coordinates.push_back(stop.coordinates);
+		}
+		std::vector<size_t> stop_ranks(coordinates.size());
+		const std::vector<size_t> stop_order = geo::ComputeHilbertOrder(coordinates);
+		for (size_t rank = 0; rank < stop_order.size(); ++rank) {
+			stop_ranks[stop_order[rank]] = rank;
+		}
+
+		// сортировка подсчётом вершин по рангу их остановки
+		std::vector<size_t> first_ids(stop_ranks.size() + 1, 0);
+		for (StopPtr stop : vertex_stops_) {
+			++first_ids[stop_ranks[stop->id] + 1];
+		}
+		for (size_t rank = 0; rank < stop_ranks.size(); ++rank) {
+			first_ids[rank + 1] += first_ids[rank];
+		}
+		std::vector<graph::VertexId> new_vertex_ids(vertex_stops_.size());
+		for (graph::VertexId vertex = 0; vertex < vertex_stops_.size(); ++vertex) {
+			new_vertex_ids[vertex] = first_ids[stop_ranks[vertex_stops_[vertex]->id]]++;
+		}
+		return new_vertex_ids;
+	}
+
+	void TransportRouter::PermuteEdges(const std::vector<graph::EdgeId>& new_edge_ids) {
+		std::vector<EdgeComponents> edge_components(edge_components_.size());
+		std::vector<RouteItem> edge_items(edge_items_.size());
+		for (graph::EdgeId edge_id = 0; edge_id < new_edge_ids.size(); ++edge_id) {
+			edge_components[new_edge_ids[edge_id]] = edge_components_[edge_id];
+			edge_items[new_edge_ids[edge_id]] = edge_items_[edge_id];
+		}
+		edge_components_ = std::move(edge_components);
+		edge_items_ = std::move(edge_items);
+	}
+
+	std::unique_ptr<graph::RouterBase<double>> TransportRouter::MakeRouter() const {
+		switch (engine_) {
+		case RouterEngineType::ALL_PAIRS_COMPACT:
+			return std::make_unique<graph::CompactRouter<double>>(graph_, *thread_pool_);
+		case RouterEngineType::ALL_PAIRS_FIXED:
+			return std::make_unique<graph::CompactRouter<double, uint32_t>>(graph_, *thread_pool_);
+		case RouterEngineType::DIJKSTRA:
+			return std::make_unique<graph::DijkstraRouter<double>>(graph_);
+		case RouterEngineType::BIDIRECTIONAL_DIJKSTRA:
+			return std::make_unique<graph::BidirectionalDijkstraRouter<double>>(graph_);
+		case RouterEngineType::A_STAR:
+			return std::make_unique<graph::DijkstraRouter<double>>(graph_, MakeGeoHeuristic());
+		case RouterEngineType::CONTRACTION_HIERARCHY:
+			return std::make_unique<graph::ContractionHierarchy<double>>(graph_);
+		case RouterEngineType::ALL_PAIRS:
+		default:
+			return std::make_unique<graph::Router<double>>(graph_);
+		}
+	}
+
+	// Точка на сфере радиуса Земли в декартовых координатах, метры
+	std::array<double, 3> ToCartesian(geo::Coordinates coordinates) {
+		const double lat = coordinates.lat * geo::DEGREE_TO_RADIAN;
+		const double lng = coordinates.lng * geo::DEGREE_TO_RADIAN;
+		return { geo::EARTH_RADIUS * std::cos(lat) * std::cos(lng), geo::EARTH_RADIUS * std::cos(lat) * std::sin(lng), geo::EARTH_RADIUS * std::sin(lat) };
+	}
+
+	graph::DijkstraRouter<double>::Heuristic TransportRouter::MakeGeoHeuristic() const {
+		// Наименьшее время на метр расстояния по прямой среди рёбер между разными остановками.
+		// Время любого пути не меньше расстояния по прямой, умноженного на этот коэффициент,
+		// поэтому эвристика допустима и согласована, даже если дорожное расстояние короче
+		// расстояния по прямой. Запас 0.1% покрывает погрешность вычисления расстояний.
+		double time_per_meter = std::numeric_limits<double>::max();
+		for (graph::EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+			const graph::Edge<double>& edge = graph_.GetEdge(edge_id);
+			StopPtr stop_from = vertex_stops_[edge.from];
+			StopPtr stop_to = vertex_stops_[edge.to];
+			if (stop_from == stop_to) {
+				continue;
+			}
+			const double distance = geo::ComputeDistance(stop_from->coordinates, stop_to->coordinates);
+			if (distance > 0.0) {
+				time_per_meter = std::min(time_per_meter, edge.weight / distance);
+			}
+		}
+		if (time_per_meter == std::numeric_limits<double>::max()) {
+			return {};
+		}
+		time_per_meter *= 0.999;
+
+		// Вместо расстояния по дуге берётся длина хорды: она не больше дуги и тоже удовлетворяет
+		// неравенству треугольника, а считается без тригонометрии на каждую вершину поиска
+		std::vector<std::array<double, 3>> points;
+		points.reserve(vertex_stops_.size());
+		for (StopPtr stop : vertex_stops_) {
+			points.push_back(ToCartesian(stop->coordinates));
+		}
+
+		return [points = std::move(points), time_per_meter](graph::VertexId vertex, graph::VertexId to) {
+			const double dx = points[vertex][0] - points[to][0];
+			const double dy = points[vertex][1] - points[to][1];
+			const double dz = points[vertex][2] - points[to][2];
+			return std::sqrt(dx * dx + dy * dy + dz * dz) * time_per_meter;
+		};
+	}
+
+	double TransportRouter::ToMilliseconds(Clock::duration duration) {
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	RouterStats TransportRouter::GetStats() const {
+		RouterStats stats;
+		stats.engine = engine_;
+		stats.estimated_memory = estimated_memory_;
+		stats.graph_model = settings_.graph_model;
+		stats.vertex_count = graph_.GetVertexCount();
+		stats.edge_count = graph_.GetEdgeCount();
+		stats.graph_build_time = ToMilliseconds(graph_build_time_);
+		stats.router_build_time = ToMilliseconds(router_build_time_);
+		stats.query_count = query_count_;
+		stats.total_query_time = ToMilliseconds(Clock::duration{ query_time_ });
+		stats.settled_vertex_count = router_ ? router_->GetSettledVertexCount() : 0;
+		stats.cache_hit_count = route_cache_.GetHitCount();
+		stats.cache_miss_count = route_cache_.GetMissCount();
+		stats.snapshot_loaded = snapshot_loaded_;
+		stats.disabled_edge_count = graph_.GetDisabledEdgeCount();
+		stats.disruption_update_time = ToMilliseconds(disruption_update_time_);
+		return stats;
+	}
+
 	std::optional<Route> TransportRouter::FindRoute(StopPtr stop_from, StopPtr stop_to) const {
-		size_t hub_stop_from_index = stop_vertices_.at(stop_from).first;
-		size_t hub_stop_to_index = stop_vertices_.at(stop_to).first;
-		std::optional<graph::Router<double>::RouteInfo> route_info = router_.BuildRoute(hub_stop_from_index, hub_stop_to_index);
-		
+		Route route;
+		if (!FindRoute(stop_from, stop_to, route)) {
+			return std::nullopt;
+		}
+		return route;
+	}
+
+	bool TransportRouter::FindRoute(StopPtr stop_from, StopPtr stop_to, Route& route) const {
+		bool is_found = false;
+		const bool is_cached = route_cache_.Visit({ stop_from, stop_to }, [&route, &is_found](const std::optional<Route>& cached_route) {
+			is_found = cached_route.has_value();
+			if (is_found) {
+				route = *cached_route;
+			}
+		});
+		if (is_cached) {
+			return is_found;
+		}
+
+		const Clock::time_point query_start = Clock::now();
+		is_found = raptor_router_ ? raptor_router_->FindRoute(stop_from, stop_to, route) : FindGraphRoute(stop_from, stop_to, route);
+		query_time_ += (Clock::now() - query_start).count();
+		++query_count_;
+		if (route_cache_.GetCapacity() > 0) {
+			route_cache_.Put({ stop_from, stop_to }, is_found ? std::optional<Route>{ route } : std::nullopt);
+		}
+		return is_found;
+	}
+
+	graph::VertexId TransportRouter::GetHubVertex(StopPtr stop) const {
+		// GetStop возвращает nullptr для неизвестного названия
+		if (stop == nullptr || stop->id >= stop_vertices_.size()) {
+			throw std::out_of_range("Unknown stop");
+		}
+		return stop_vertices_[stop->id].first;
+	}
+
+	bool TransportRouter::FindGraphRoute(StopPtr stop_from, StopPtr stop_to, Route& route) const {
+		// рёбра маршрута - в буфере потока, память которого переиспользуется между запросами
+		static thread_local RouteInfo route_info;
+		size_t hub_stop_from_index = GetHubVertex(stop_from);
+		size_t hub_stop_to_index = GetHubVertex(stop_to);
+		if (!router_->FillRoute(hub_stop_from_index, hub_stop_to_index, route_info)) {
+			return false;
+		}
+		MakeRoute(route_info, route);
+		return true;
+	}
+
+	std::optional<Route> TransportRouter::FindRoute(StopPtr stop_from, StopPtr stop_to, double departure_time) const {
+		if (raptor_router_) {
+			throw std::logic_error("Time-dependent routing needs a graph engine");
+		}
+		size_t hub_stop_from_index = GetHubVertex(stop_from);
+		size_t hub_stop_to_index = GetHubVertex(stop_to);
+
+		const Clock::time_point query_start = Clock::now();
+		std::optional<RouteInfo> route_info = graph::BuildTimeDependentRoute(graph_, hub_stop_from_index, hub_stop_to_index, departure_time,
+			[this](graph::EdgeId edge_id, double time) {
+				return GetArrivalTime(edge_id, time);
+			});
+		query_time_ += (Clock::now() - query_start).count();
+		++query_count_;
+
 		if (!route_info.has_value()) {
 			return std::nullopt;
 		}
+		return MakeTimeDependentRoute(*route_info, departure_time);
+	}
 
+	double TransportRouter::GetArrivalTime(graph::EdgeId edge_id, double time) const {
+		// ожидание переносится с рёбер hub -> terminal на рёбра посадки: у каждого автобуса оно своё
+		const EdgeComponents& components = edge_components_[edge_id];
+		const double ride_time = GetRideTime(components.distance);
+		if (components.departure_bus == nullptr) {
+			return time + ride_time + GetWalkTime(components.walk_distance);
+		}
+		const BusSchedule& schedule = components.departure_bus->schedule;
+		if (schedule.IsEmpty()) {
+			return time + settings_.bus_wait_time + ride_time;
+		}
+		const double departure_offset = GetRideTime(components.departure_distance);
+		return schedule.GetNextDeparture(time - departure_offset) + departure_offset + ride_time;
+	}
+
+	Route TransportRouter::MakeTimeDependentRoute(const RouteInfo& route_info, double departure_time) const {
 		Route route;
-		route.total_time = (*route_info).weight;
-		for (size_t i : (*route_info).edges) {
-			route.items.emplace_back(edge_stats_.at(i));
+		route.total_time = route_info.weight - departure_time;
+		double time = departure_time;
+		for (graph::EdgeId edge_id : route_info.edges) {
+			const EdgeComponents& components = edge_components_[edge_id];
+			const double arrival_time = GetArrivalTime(edge_id, time);
+			if (components.departure_bus != nullptr) {
+				const double wait_time = arrival_time - time - GetRideTime(components.distance);
+				route.items.push_back(RouteItem::Wait(vertex_stops_[graph_.GetEdge(edge_id).from]->name, wait_time));
+			}
+			time = arrival_time;
+
+			const RouteItem& item = edge_items_[edge_id];
+			if (item.type == RouteType::WALK) {
+				route.items.push_back(item);
+				continue;
+			}
+			if (item.type != RouteType::BUS) {
+				continue;
+			}
+			if (route.items.back().type == RouteType::BUS) {
+				route.items.back().time += item.time;
+				route.items.back().span_count += item.span_count;
+				continue;
+			}
+			route.items.push_back(item);
+		}
+		return route;
+	}
+
+	std::vector<Route> TransportRouter::FindAlternativeRoutes(StopPtr stop_from, StopPtr stop_to, size_t count) const {
+		if (raptor_router_) {
+			throw std::logic_error("Alternative routes need a graph engine");
+		}
+		size_t hub_stop_from_index = GetHubVertex(stop_from);
+		size_t hub_stop_to_index = GetHubVertex(stop_to);
+
+		const Clock::time_point query_start = Clock::now();
+		std::vector<RouteInfo> route_infos = graph::FindKShortestPaths(graph_, hub_stop_from_index, hub_stop_to_index, count);
+		query_time_ += (Clock::now() - query_start).count();
+		++query_count_;
+
+		std::vector<Route> routes;
+		routes.reserve(route_infos.size());
+		for (const auto& route_info : route_infos) {
+			routes.push_back(MakeRoute(route_info));
+		}
+		return routes;
+	}
+
+	std::vector<ParetoRoute> TransportRouter::FindParetoRoutes(StopPtr stop_from, StopPtr stop_to) const {
+		if (raptor_router_) {
+			const Clock::time_point query_start = Clock::now();
+			std::vector<ParetoRoute> routes = raptor_router_->FindParetoRoutes(stop_from, stop_to);
+			query_time_ += (Clock::now() - query_start).count();
+			++query_count_;
+			return routes;
 		}
+		size_t hub_stop_from_index = GetHubVertex(stop_from);
+		size_t hub_stop_to_index = GetHubVertex(stop_to);
 
+		// считаются посадки - рёбра с ожиданием; пересадок на одну меньше
+		const Clock::time_point query_start = Clock::now();
+		std::vector<graph::ParetoRouteInfo<double>> route_infos = graph::BuildParetoRoutes(graph_, hub_stop_from_index, hub_stop_to_index,
+			[this](graph::EdgeId edge_id) {
+				return edge_components_[edge_id].wait_count > 0;
+			});
+		query_time_ += (Clock::now() - query_start).count();
+		++query_count_;
+
+		std::vector<ParetoRoute> routes;
+		routes.reserve(route_infos.size());
+		for (auto& route_info : route_infos) {
+			const int transfer_count = route_info.count > 0 ? static_cast<int>(route_info.count) - 1 : 0;
+			// пеший маршрут без посадок и маршрут с одной посадкой оба без пересадок: остаётся более быстрый
+			if (!routes.empty() && routes.back().transfer_count == transfer_count) {
+				continue;
+			}
+			routes.push_back({ MakeRoute({ route_info.weight, std::move(route_info.edges) }), transfer_count });
+		}
+		return routes;
+	}
+
+	std::vector<ReachableStop> TransportRouter::FindReachableStops(StopPtr stop_from, double max_time) const {
+		if (raptor_router_) {
+			throw std::logic_error("Reachable stops search needs a graph engine");
+		}
+		size_t hub_stop_from_index = GetHubVertex(stop_from);
+
+		const Clock::time_point query_start = Clock::now();
+		const std::vector<std::pair<graph::VertexId, double>> vertices = graph::BuildReachableVertices(graph_, hub_stop_from_index, max_time);
+		query_time_ += (Clock::now() - query_start).count();
+		++query_count_;
+
+		// на остановку приезжают в её hub; terminal и вершины поездок не означают, что остановка достигнута
+		std::vector<ReachableStop> stops;
+		for (const auto& [vertex, time] : vertices) {
+			StopPtr stop = vertex_stops_[vertex];
+			if (stop_vertices_.at(stop->id).first == vertex) {
+				stops.push_back({ stop, time });
+			}
+		}
+		return stops;
+	}
+
+	std::vector<std::optional<Route>> TransportRouter::FindRoutes(StopPtr stop_from, const std::vector<StopPtr>& stops_to) const {
+		const Clock::time_point query_start = Clock::now();
+		std::vector<std::optional<Route>> routes = raptor_router_ ? raptor_router_->FindRoutes(stop_from, stops_to) : FindGraphRoutes(stop_from, stops_to);
+		query_time_ += (Clock::now() - query_start).count();
+		++query_count_;
+		return routes;
+	}
+
+	std::vector<std::vector<std::optional<Route>>> TransportRouter::FindRouteMatrix(const std::vector<StopPtr>& stops_from, const std::vector<StopPtr>& stops_to) const {
+		std::vector<std::vector<std::optional<Route>>> matrix;
+		matrix.reserve(stops_from.size());
+		for (StopPtr stop_from : stops_from) {
+			matrix.push_back(FindRoutes(stop_from, stops_to));
+		}
+		return matrix;
+	}
+
+	std::vector<std::optional<Route>> TransportRouter::FindGraphRoutes(StopPtr stop_from, const std::vector<StopPtr>& stops_to) const {
+		std::vector<graph::VertexId> hub_stop_to_indices;
+		hub_stop_to_indices.reserve(stops_to.size());
+		for (StopPtr stop_to : stops_to) {
+			hub_stop_to_indices.push_back(GetHubVertex(stop_to));
+		}
+		std::vector<std::optional<RouteInfo>> route_infos = router_->BuildRoutes(GetHubVertex(stop_from), hub_stop_to_indices);
+
+		std::vector<std::optional<Route>> routes;
+		routes.reserve(route_infos.size());
+		for (const auto& route_info : route_infos) {
+			if (route_info.has_value()) {
+				routes.emplace_back(MakeRoute(*route_info));
+			}
+			else {
+				routes.emplace_back(std::nullopt);
+			}
+		}
+		return routes;
+	}
+
+	Route TransportRouter::MakeRoute(const RouteInfo& route_info) const {
+		Route route;
+		MakeRoute(route_info, route);
 		return route;
 	}
 
+	void TransportRouter::MakeRoute(const RouteInfo& route_info, Route& route) const {
+		route.total_time = route_info.weight;
+		route.items.clear();
+		for (graph::EdgeId edge_id : route_info.edges) {
+			const RouteItem& item = edge_items_[edge_id];
+			if (item.type == RouteType::NONE) {
+				// рёбра посадки и высадки модели RIDE_CHAINS не дают элементов маршрута
+				continue;
+			}
+			if (item.type == RouteType::BUS && !route.items.empty() && route.items.back().type == RouteType::BUS) {
+				// перегоны одной поездки объединяются; в модели STOP_PAIRS поездки всегда разделены ожиданием
+				route.items.back().time += item.time;
+				route.items.back().span_count += item.span_count;
+				continue;
+			}
+			route.items.push_back(item);
+		}
+	}
+
 } // namespace tc::router
\ No newline at end of file
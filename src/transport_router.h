@@ -1,110 +1,368 @@
 #pragma once
 
+#include "compact_router.h"
+#include "contraction_hierarchy.h"
+#include "dijkstra_router.h"
 #include "domain.h"
 #include "graph.h"
+#include "k_shortest_paths.h"
+#include "lru_cache.h"
+#include "mapped_file.h"
+#include "pareto_routes.h"
 #include "ranges.h"
 #include "router.h"
+#include "thread_pool.h"
 #include "transport_catalogue.h"
 
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <string>
 #include <string_view>
-#include <unordered_map>
 
 namespace tc::router {
 
 	using namespace ::std::string_literals;
 
+	enum RouterEngineType {
+		ALL_PAIRS,	//      
+		ALL_PAIRS_COMPACT,	//        float
+		ALL_PAIRS_FIXED,	//        uint32_t   
+		DIJKSTRA,	//     
+		A_STAR,	//          
+		BIDIRECTIONAL_DIJKSTRA,	//       
+		CONTRACTION_HIERARCHY,	//  :  ,  
+		RAPTOR,	//       ,   
+		AUTO	//       ,     memory_budget;
+			// RAPTOR  :       ,   
+	};
+
+	enum GraphModelType {
+		STOP_PAIRS,	//        : O(n^2)   
+		RIDE_CHAINS	//          : O(n) 
+	};
+
+	//   .      -     
+	//       .
+	enum VertexOrderType {
+		INPUT_ORDER,	//      
+		CUTHILL_MCKEE,	//   -   
+		HILBERT	//      ;    
+	};
+
 	struct RoutingSettings {
 		int bus_wait_time = 6;
 		double bus_velocity = 40.0;
+		//   memory_budget -  :     
+		//    ,   ,   AUTO;     ,
+		//  A* -    
+		RouterEngineType engine = RouterEngineType::ALL_PAIRS;
+		size_t memory_budget = 0;	//    ; 0 -   ( AUTO - DEFAULT_MEMORY_BUDGET)
+		GraphModelType graph_model = GraphModelType::STOP_PAIRS;
+		VertexOrderType vertex_order = VertexOrderType::INPUT_ORDER;
+		double walk_radius = 0.0;	//          ; 0 -  
+		double walk_velocity = 5.0;	// /
+		size_t route_cache_capacity = 0;	//     FindRoute; 0 -  
+		std::string snapshot_path;	//     ;  -  
 	};
 
 	enum RouteType {
 		WAIT,
-		BUS
+		BUS,
+		WALK,
+		NONE	//     :     RIDE_CHAINS
 	};
 
-	struct RouteStat {
+	//   -  :    name,    name
+	//  span_count       name   to_name.
+	//    ,    .
+	struct RouteItem {
+		RouteType type = RouteType::NONE;
+		std::string_view name;
 		double time = 0.0;
-		virtual RouteType GetType() const = 0;
-	protected:
-		virtual ~RouteStat() = default;
-		RouteStat(double time) : time(time) {
-		}
-	};
+		int span_count = 0;
+		std::string_view to_name;
 
-	struct WaitRouteStat : RouteStat {
+		static RouteItem Wait(std::string_view stop_name, double time) {
+			return { RouteType::WAIT, stop_name, time, 0, {} };
+		}
 
-		WaitRouteStat(std::string_view stop_name, double time) : RouteStat(time), stop_name(stop_name) {
+		static RouteItem Bus(std::string_view bus_name, double time, int span_count) {
+			return { RouteType::BUS, bus_name, time, span_count, {} };
 		}
 
-		std::string_view stop_name;
-		RouteType GetType() const override{
-			return RouteType::WAIT;
+		static RouteItem Walk(std::string_view stop_from_name, std::string_view stop_to_name, double time) {
+			return { RouteType::WALK, stop_from_name, time, 0, stop_to_name };
 		}
 	};
 
-	struct BusRouteStat : RouteStat {
+	struct Route {
+		double total_time = 0.0;
+		std::vector<RouteItem> items;
+	};
 
-		BusRouteStat(std::string_view bus_name, double time, int span_count) : RouteStat(time), bus_name(bus_name), span_count(span_count) {
-		}
+	//        ;   
+	struct RouterStats {
+		RouterEngineType engine = RouterEngineType::ALL_PAIRS;	//  ,  AUTO
+		size_t estimated_memory = 0;	//     , 
+		GraphModelType graph_model = GraphModelType::STOP_PAIRS;
+		size_t vertex_count = 0;
+		size_t edge_count = 0;
+		double graph_build_time = 0.0;
+		double router_build_time = 0.0;
+		size_t query_count = 0;
+		double total_query_time = 0.0;
+		size_t settled_vertex_count = 0;	//       
+		size_t cache_hit_count = 0;	//  FindRoute,    
+		size_t cache_miss_count = 0;
+		bool snapshot_loaded = false;	//      ,   
+		size_t disabled_edge_count = 0;	//  ,      
+		double disruption_update_time = 0.0;	//   SetStopClosed  SetBusSuspended
+	};
 
-		std::string_view bus_name;
-		int span_count;
-		RouteType GetType() const override {
-			return RouteType::BUS;
-		}
+	//         
+	struct ParetoRoute {
+		Route route;
+		int transfer_count = 0;
 	};
 
-	struct Route {
-		double total_time = 0.0;
-		std::vector<std::shared_ptr<RouteStat>> items;
+	// ,    ,       
+	struct ReachableStop {
+		StopPtr stop = nullptr;
+		double time = 0.0;
 	};
 
+	class RaptorRouter;
+
 
 	class TransportRouter {
 	public:
-		TransportRouter(const TransportCatalogue& transport_catalogue, RoutingSettings settings) :
-			transport_catalogue_(transport_catalogue),
-			settings_(std::move(settings)),
-			graph_(std::move(ConstructGraph())),
-			router_(graph_) {
-		}
+		TransportRouter(const TransportCatalogue& transport_catalogue, RoutingSettings settings);
+		~TransportRouter();
+
+		//      ,     :
+		//         ,
+		//     .   .
+		//      .
+		void ApplySettings(RoutingSettings settings);
+
+		//  ,     CompactRouter (  ALL_PAIRS_COMPACT)  .
+		//   snapshot_path   ,       
+		//  ,        .
+		void SaveSnapshot(const std::string& path) const;
+
+		//      .     ,   
+		//    ,     ;    .
+		// и   ;       ,
+		//        , RAPTOR      .
+		//   .      .
+		void SetStopClosed(StopPtr stop, bool is_closed);
+		void SetBusSuspended(BusPtr bus, bool is_suspended);
+		bool IsStopClosed(StopPtr stop) const;
+		bool IsBusSuspended(BusPtr bus) const;
 
 		std::optional<Route> FindRoute(StopPtr stop_from, StopPtr stop_to) const;
+		//    route,    :      
+		// route    RAPTOR    (     ).
+		//  false,   .
+		bool FindRoute(StopPtr stop_from, StopPtr stop_to, Route& route) const;
+		//      departure_time (   ):   
+		//        ,    
+		//  bus_wait_time.      ,    .
+		std::optional<Route> FindRoute(StopPtr stop_from, StopPtr stop_to, double departure_time) const;
+		//  count       ,  - 
+		std::vector<Route> FindAlternativeRoutes(StopPtr stop_from, StopPtr stop_to, size_t count) const;
+		// ,        (,  ):   ,
+		//       .     .
+		std::vector<ParetoRoute> FindParetoRoutes(StopPtr stop_from, StopPtr stop_to) const;
+		// ,      stop_from     max_time ,   ;
+		//  stop_from -   .    ,  max_time.
+		std::vector<ReachableStop> FindReachableStops(StopPtr stop_from, double max_time) const;
+		//       stops_to;      
+		std::vector<std::optional<Route>> FindRoutes(StopPtr stop_from, const std::vector<StopPtr>& stops_to) const;
+		//  :     stops_from,  -   stops_to
+		std::vector<std::vector<std::optional<Route>>> FindRouteMatrix(const std::vector<StopPtr>& stops_from, const std::vector<StopPtr>& stops_to) const;
+		RouterStats GetStats() const;
+
+		//      AUTO   memory_budget
+		static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t{ 1 } << 30;
 
 	private:
+		using Clock = std::chrono::steady_clock;
 
-		template <typename ConstIt>
-		void SetRouteEdges(graph::DirectedWeightedGraph<double>& graph, const std::string& bus_name, ConstIt stop_ptr_begin, ConstIt stop_ptr_end) {
+		struct StopPairHasher {
+			size_t operator()(const std::pair<StopPtr, StopPtr>& stops) const {
+				return std::hash<StopPtr>{}(stops.first) * 37 + std::hash<StopPtr>{}(stops.second);
+			}
+		};
+		using RouteCache = util::LruCache<std::pair<StopPtr, StopPtr>, std::optional<Route>, StopPairHasher>;
+		using RouteInfo = graph::RouterBase<double>::RouteInfo;
+
+		//   ,    :
+		//  = wait_count * bus_wait_time + distance / bus_velocity + walk_distance / walk_velocity
+		struct EdgeComponents {
+			int distance = 0;	// 
+			int wait_count = 0;
+			//    -          ,
+			//       
+			BusPtr departure_bus = nullptr;
+			int departure_distance = 0;
+			int walk_distance = 0;	//  
+		};
+
+		double GetRideTime(int distance) const {
 			const double velocity_coefficient = 60.0 / 1000.0;
+			return distance / settings_.bus_velocity * velocity_coefficient;
+		}
+
+		double GetWalkTime(int walk_distance) const {
+			const double velocity_coefficient = 60.0 / 1000.0;
+			return walk_distance / settings_.walk_velocity * velocity_coefficient;
+		}
+
+		double GetEdgeWeight(EdgeComponents components) const {
+			return components.wait_count * settings_.bus_wait_time + GetRideTime(components.distance) + GetWalkTime(components.walk_distance);
+		}
+
+		// и    ,     .
+		// и     ,     ;   
+		//  first_ride_vertex,       .
+		struct EdgeBlock {
+			size_t first_ride_vertex = 0;
+			std::vector<graph::Edge<double>> edges;
+			std::vector<EdgeComponents> components;
+			std::vector<RouteItem> items;
+			std::vector<StopPtr> ride_vertex_stops;
+		};
+
+		size_t AddEdge(graph::DirectedWeightedGraph<double>& graph, size_t from, size_t to, EdgeComponents components) {
+			edge_components_.push_back(components);
+			edge_items_.emplace_back();
+			return graph.AddEdge({ from, to, GetEdgeWeight(components) });
+		}
+
+		//    ; item.time,   , -  
+		void AddEdge(EdgeBlock& block, size_t from, size_t to, EdgeComponents components, RouteItem item = {}) const {
+			const double weight = GetEdgeWeight(components);
+			item.time = item.type == RouteType::NONE ? 0.0 : weight;
+			block.edges.push_back({ from, to, weight });
+			block.components.push_back(components);
+			block.items.push_back(item);
+		}
 
+		// distance_offsets[i] -      i-  bus.stops
+		template <typename ConstIt>
+		void SetRouteEdges(EdgeBlock& block, const Bus& bus, const std::vector<int>& distance_offsets, ConstIt stop_ptr_begin, ConstIt stop_ptr_end) const {
 			for (ConstIt from_it = stop_ptr_begin; from_it != stop_ptr_end; ++from_it) {
-				double time = 0.0;
 				int span_count = 0;
-				size_t terminal_stop_from_index = stop_vertices_.at(*from_it).second;
+				size_t terminal_stop_from_index = stop_vertices_[(*from_it)->id].second;
+				const int departure_distance = distance_offsets[from_it - bus.stops.cbegin()];
 				for (ConstIt to_it = from_it + 1; to_it != stop_ptr_end; ++to_it) {
 					if (*from_it == *to_it) {
 						continue;
 					}
-					time += transport_catalogue_.GetDistance(*(to_it-1), *to_it) / settings_.bus_velocity * velocity_coefficient;
-					size_t hub_stop_to_index = stop_vertices_.at(*to_it).first;
-					size_t edge_id = graph.AddEdge({ terminal_stop_from_index, hub_stop_to_index, time });
-					edge_stats_[edge_id] = std::make_shared<BusRouteStat>(bus_name, time, ++span_count);
+					const int distance = distance_offsets[to_it - bus.stops.cbegin()] - departure_distance;
+					size_t hub_stop_to_index = stop_vertices_[(*to_it)->id].first;
+					AddEdge(block, terminal_stop_from_index, hub_stop_to_index, { distance, 0, &bus, departure_distance }, RouteItem::Bus(bus.name, 0.0, ++span_count));
+				}
+			}
+		}
+
+		//     -   ;    ,
+		//    terminal ,  -   hub.   
+		//       FindRoute.
+		template <typename ConstIt>
+		void SetRideEdges(EdgeBlock& block, const Bus& bus, const std::vector<int>& distance_offsets, ConstIt stop_ptr_begin, ConstIt stop_ptr_end) const {
+			size_t prev_ride_vertex_index = 0;
+			for (ConstIt stop_it = stop_ptr_begin; stop_it != stop_ptr_end; ++stop_it) {
+				size_t ride_vertex_index = block.first_ride_vertex + block.ride_vertex_stops.size();
+				block.ride_vertex_stops.push_back(*stop_it);
+				const auto [hub_stop_index, terminal_stop_index] = stop_vertices_[(*stop_it)->id];
+				if (stop_it != stop_ptr_begin) {
+					const size_t stop_index = stop_it - bus.stops.cbegin();
+					const int distance = distance_offsets[stop_index] - distance_offsets[stop_index - 1];
+					AddEdge(block, prev_ride_vertex_index, ride_vertex_index, { distance, 0 }, RouteItem::Bus(bus.name, 0.0, 1));
+					AddEdge(block, ride_vertex_index, hub_stop_index, {});
 				}
+				if (stop_it + 1 != stop_ptr_end) {
+					AddEdge(block, terminal_stop_index, ride_vertex_index, { 0, 0, &bus, distance_offsets[stop_it - bus.stops.cbegin()] });
+				}
+				prev_ride_vertex_index = ride_vertex_index;
+			}
+		}
+
+		template <typename ConstIt>
+		void SetBusEdges(EdgeBlock& block, const Bus& bus, const std::vector<int>& distance_offsets, ConstIt stop_ptr_begin, ConstIt stop_ptr_end) const {
+			if (settings_.graph_model == GraphModelType::RIDE_CHAINS) {
+				SetRideEdges(block, bus, distance_offsets, stop_ptr_begin, stop_ptr_end);
+			}
+			else {
+				SetRouteEdges(block, bus, distance_offsets, stop_ptr_begin, stop_ptr_end);
 			}
 		}
 
 		void AddStopsToGraph(graph::DirectedWeightedGraph<double>& graph);
+		void AddBusEdges(EdgeBlock& block, const Bus& bus) const;
 		void AddBussesToGraph(graph::DirectedWeightedGraph<double>& graph);
+		void AddWalksToGraph(graph::DirectedWeightedGraph<double>& graph);
+		size_t CountRideVertices(const Bus& bus) const;
+		size_t CountVertices() const;
 		graph::DirectedWeightedGraph<double> ConstructGraph();
+		void FreezeGraph(graph::DirectedWeightedGraph<double>& graph);
+		void ReorderVertices(graph::DirectedWeightedGraph<double>& graph);
+		std::vector<graph::VertexId> ComputeHilbertVertexIds() const;
+		void PermuteEdges(const std::vector<graph::EdgeId>& new_edge_ids);
+		size_t EstimateRouterMemory(RouterEngineType engine) const;
+		RouterEngineType ChooseEngine() const;
+		void BuildRouter();
+		bool LoadSnapshot(const std::string& path);
+		void ReweightGraph();
+		bool HasDisruptions() const;
+		bool IsClosedStopVertex(graph::VertexId vertex) const;
+		bool IsEdgeDisrupted(graph::EdgeId edge_id) const;
+		void IndexDisruptableEdges();
+		std::vector<graph::EdgeId> MaskDisruptedEdges();
+		std::vector<graph::EdgeId> MaskDisruptedEdges(const std::vector<graph::EdgeId>& edge_ids);
+		void ApplyDisruptions(const std::vector<graph::EdgeId>& edge_ids);
+		std::unique_ptr<graph::RouterBase<double>> MakeRouter() const;
+		graph::DijkstraRouter<double>::Heuristic MakeGeoHeuristic() const;
+		static double ToMilliseconds(Clock::duration duration);
+		// hub ;  nullptr     std::out_of_range
+		graph::VertexId GetHubVertex(StopPtr stop) const;
+		bool FindGraphRoute(StopPtr stop_from, StopPtr stop_to, Route& route) const;
+		std::vector<std::optional<Route>> FindGraphRoutes(StopPtr stop_from, const std::vector<StopPtr>& stops_to) const;
+		Route MakeRoute(const RouteInfo& route_info) const;
+		void MakeRoute(const RouteInfo& route_info, Route& route) const;
+		double GetArrivalTime(graph::EdgeId edge_id, double time) const;
+		Route MakeTimeDependentRoute(const RouteInfo& route_info, double departure_time) const;
 
 		const TransportCatalogue& transport_catalogue_;
 		RoutingSettings settings_;
-		std::unordered_map<StopPtr, std::pair<size_t, size_t>> stop_vertices_; //    - hub,  ;  - terminal,    bus_wait_time
-		std::unordered_map<size_t, std::shared_ptr<RouteStat>> edge_stats_;
+		RouterEngineType engine_ = RouterEngineType::ALL_PAIRS;	//   settings_.engine  memory_budget
+		size_t estimated_memory_ = 0;
+		//      ;   router_,     
+		std::unique_ptr<util::ThreadPool> thread_pool_;
+		std::vector<std::pair<size_t, size_t>> stop_vertices_; //  Stop::id;    - hub,  ;  - terminal,    bus_wait_time
+		std::vector<RouteItem> edge_items_;	//    :  ,   
+		std::vector<StopPtr> vertex_stops_;	// ,     
+		std::vector<EdgeComponents> edge_components_;	//    
 		graph::DirectedWeightedGraph<double> graph_;
-		graph::Router<double> router_;
+		std::unique_ptr<util::MappedFile> snapshot_file_;	//  router_     
+		std::unique_ptr<graph::RouterBase<double>> router_;
+		std::unique_ptr<RaptorRouter> raptor_router_;	//    router_   RAPTOR
+		Clock::duration graph_build_time_{};
+		Clock::duration router_build_time_{};
+		bool snapshot_loaded_ = false;
+		std::vector<char> closed_stops_;	//  Stop::id
+		std::vector<char> suspended_buses_;	//  Bus::id
+		// ,      (     hub  terminal)
+		//    (  );  Stop::id  Bus::id,   RAPTOR 
+		std::vector<std::vector<graph::EdgeId>> stop_edges_;
+		std::vector<std::vector<graph::EdgeId>> bus_edges_;
+		Clock::duration disruption_update_time_{};
+		mutable RouteCache route_cache_;	//   FindRoute,   
+		mutable std::atomic<size_t> query_count_ = 0;
+		mutable std::atomic<Clock::rep> query_time_ = 0;
 	};
 
 } // namespace tc::router
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace graph {
+
+// Обратный порядок Катхилла-Макки по графу без учёта направления рёбер: обход в ширину от вершины
+// наименьшей степени, соседи добавляются по возрастанию степени, затем порядок обращается.
+// Соседние вершины получают близкие номера, поэтому строки таблиц по вершинам и метки поиска
+// соседей лежат рядом в памяти. Возвращает новые номера вершин: new_vertex_ids[старый номер].
+template <typename Weight>
+std::vector<VertexId> ComputeCuthillMcKeeOrder(const DirectedWeightedGraph<Weight>& graph) {
+    if (!graph.IsFrozen()) {
+        throw std::invalid_argument("Graph should be frozen");
+    }
+    const size_t vertex_count = graph.GetVertexCount();
+
+    // соседи без направления в виде смещений и одного массива, петли не учитываются
+    std::vector<size_t> neighbour_offsets(vertex_count + 1, 0);
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const Edge<Weight>& edge = graph.GetEdge(edge_id);
+        if (edge.from != edge.to) {
+            ++neighbour_offsets[edge.from + 1];
+            ++neighbour_offsets[edge.to + 1];
+        }
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        neighbour_offsets[vertex + 1] += neighbour_offsets[vertex];
+    }
+    std::vector<VertexId> neighbours(neighbour_offsets.back());
+    {
+        std::vector<size_t> fill_positions(neighbour_offsets.begin(), neighbour_offsets.end() - 1);
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            const Edge<Weight>& edge = graph.GetEdge(edge_id);
+            if (edge.from != edge.to) {
+                neighbours[fill_positions[edge.from]++] = edge.to;
+                neighbours[fill_positions[edge.to]++] = edge.from;
+            }
+        }
+    }
+    const auto get_degree = [&neighbour_offsets](VertexId vertex) {
+        return neighbour_offsets[vertex + 1] - neighbour_offsets[vertex];
+    };
+    const auto by_degree = [&get_degree](VertexId lhs, VertexId rhs) {
+        return get_degree(lhs) < get_degree(rhs);
+    };
+
+    // вершины по возрастанию степени - начала обхода для каждой компоненты связности
+    std::vector<VertexId> start_vertices(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        start_vertices[vertex] = vertex;
+    }
+    std::stable_sort(start_vertices.begin(), start_vertices.end(), by_degree);
+
+    std::vector<VertexId> order;
+    order.reserve(vertex_count);
+    std::vector<char> is_visited(vertex_count, 0);
+    for (const VertexId start_vertex : start_vertices) {
+        if (is_visited[start_vertex]) {
+            continue;
+        }
+        is_visited[start_vertex] = 1;
+        order.push_back(start_vertex);
+        // order служит очередью обхода: вершины компоненты дописываются в конец
+        for (size_t queue_index = order.size() - 1; queue_index < order.size(); ++queue_index) {
+            const VertexId vertex = order[queue_index];
+            const size_t first_new = order.size();
+            for (size_t i = neighbour_offsets[vertex]; i < neighbour_offsets[vertex + 1]; ++i) {
+                if (!is_visited[neighbours[i]]) {
+                    is_visited[neighbours[i]] = 1;
+                    order.push_back(neighbours[i]);
+                }
+            }
+            std::stable_sort(order.begin() + first_new, order.end(), by_degree);
+        }
+    }
+
+    std::vector<VertexId> new_vertex_ids(vertex_count);
+    for (size_t position = 0; position < vertex_count; ++position) {
+        new_vertex_ids[order[position]] = vertex_count - 1 - position;
+    }
+    return new_vertex_ids;
+}
+
+}  // namespace graph